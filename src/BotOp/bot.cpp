@@ -12,6 +12,7 @@
 #include <Franka/franka.h>
 #include <Franka/FrankaGripper.h>
 #include "simulation.h"
+#include "display.h"
 #include <Omnibase/omnibase.h>
 #include <Robotiq/RobotiqGripper.h>
 #include <OptiTrack/optitrack.h>
@@ -21,10 +22,15 @@
 #endif
 
 #include <Audio/audio.h>
+#include <RealTime/rtConfig.h>
+#include <RealTime/splineRef.h>
+
+#include <thread>
+#include <algorithm>
 
 //===========================================================================
 
-BotOp::BotOp(rai::Configuration& C, bool useRealRobot){
+BotOp::BotOp(rai::Configuration& C, bool useRealRobot, int simLockstep, int _display){
   //-- launch arm(s) & gripper(s)
   bool useGripper = rai::getParameter<bool>("bot/useGripper", true);
   bool blockRealRobot = rai::getParameter<bool>("bot/blockRealRobot", false);
@@ -32,72 +38,31 @@ BotOp::BotOp(rai::Configuration& C, bool useRealRobot){
   C.ensure_indexedJoints();
   qHome = C.getJointState();
   state.set()->initZero(qHome.N);
+  channel = make_shared<CtrlChannel>(qHome.N);
+  CtrlChannel::attach(channel, cmd);
 
   if(blockRealRobot && useRealRobot){
     LOG(0) <<"-- blocking useRealRobot -- ";
     useRealRobot=false;
   }
 
-  //-- launch robots & grippers
-  if(useRealRobot && useGripper){
-    LOG(0) <<"CONNECTING TO GRIPPERS";
-    try{
-      if(C.getFrame("l_panda_hand", false) && C.getFrame("r_panda_hand", false)){
-        gripperL = make_shared<FrankaGripper>(0);
-        gripperR = make_shared<FrankaGripper>(1);
-      }else if(C.getFrame("l_panda_hand", false)){
-        gripperL = make_shared<FrankaGripper>(0);
-      }else if(C.getFrame("r_panda_hand", false)){
-        gripperR = make_shared<FrankaGripper>(1);
-
-      }else if(C.getFrame("l_robotiq_base", false) && C.getFrame("r_robotiq_base", false)){
-        gripperL = make_shared<RobotiqGripper>(0);
-        gripperR = make_shared<RobotiqGripper>(1);
-      }else if(C.getFrame("l_robotiq_base", false)){
-        gripperL = make_shared<RobotiqGripper>(0);
-      }else if(C.getFrame("r_robotiq_base", false)){
-        gripperR = make_shared<RobotiqGripper>(1);
-      }
-    } catch(const std::exception& ex) {
-      LOG(-1) <<"Starting the gripper(s) failed! Error msg: " <<ex.what();
-    }
+  //-- display mode (the display itself is opened last)
+  if(_display<0){
+    rai::String mode = rai::getParameter<rai::String>("bot/display", "sync");
+    if(mode=="sync") displayMode = displaySync;
+    else if(mode=="thread") displayMode = displayThread;
+    else if(mode=="headless") displayMode = displayHeadless;
+    else HALT("unknown bot/display mode '" <<mode <<"' (sync, thread, or headless)");
+  }else{
+    CHECK_LE(_display, (int)displayHeadless, "");
+    displayMode = DisplayMode(_display);
   }
 
-  if(useRealRobot){
-    uint robotID=0;
-    LOG(0) <<"CONNECTING TO FRANKAS";
-    try{
-      if(C.getFrame("l_panda_base", false) && C.getFrame("r_panda_base", false)){
-        robotL = make_shared<FrankaThread>(robotID++, franka_getJointIndices(C,'l'), cmd, state);
-        robotR = make_shared<FrankaThread>(robotID++, franka_getJointIndices(C,'r'), cmd, state);
-      } else if(C.getFrame("l_panda_base", false)){
-        robotL = make_shared<FrankaThread>(robotID++, franka_getJointIndices(C,'l'), cmd, state);
-      } else if(C.getFrame("r_panda_base", false)){
-        robotR = make_shared<FrankaThread>(robotID++, franka_getJointIndices(C,'r'), cmd, state);
-      }else{
-        LOG(0) <<"starting botop without franka robots (no frames l_panda_base or r_panda_base defined)";
-      }
-      C.setJointState(get_q());
-    } catch(const std::exception& ex) {
-      LOG(-1) <<"Starting the franka robot(s) failed! Error msg: " <<ex.what();
-    } catch(...) {
-      LOG(-1) <<"Starting the franka robot(s) failed! Error msg: " <<rai::errString();
-    }
-
-    try{
-      if(C.getFrame("omnibase_world", false)){
-        LOG(0) <<"CONNECTING TO OMNIBASE";
-        robotL = make_shared<OmnibaseThread>(robotID++, uintA{0,1,2}, cmd, state);
-      }
-    } catch(const std::exception& ex) {
-      LOG(-1) <<"Starting the omnibase failed! Error msg: " <<ex.what();
-    }
+  //-- launch robots & grippers
+  launchRobots(C, useRealRobot, useGripper, simLockstep);
 
-  }else{
-    simthread = make_shared<BotThreadedSim>(C, cmd, state);
-    robotL = simthread;
-    if(useGripper) gripperL = make_shared<GripperSim>(simthread, "l_gripper");
-  }
+  //-- opt-in: keep the constructing (user/MPC) thread, and the viewer/camera threads it spawns later, off the real-time CPUs
+  if(rai::getParameter<bool>("bot/nonRtUserThread", false)) rai::applyNonRtAffinity("BotOp user thread");
 
   startRealTime = rai::realTime();
 
@@ -127,28 +92,121 @@ BotOp::BotOp(rai::Configuration& C, bool useRealRobot){
     audio = make_shared<rai::Sound>();
   }
 
-  C.gl().setTitle("BotOp associated Configuration");
-  C.view(false, STRING("time: 0"));
+  //-- display
+  raiseWindowOnSync = rai::getParameter<bool>("bot/raiseWindow", false);
+  if(displayMode==displaySync){
+    C.gl().setTitle("BotOp associated Configuration");
+    C.view(false, STRING("time: 0"));
+  }else if(displayMode==displayThread){
+    display = make_shared<BotDisplay>(C, rai::getParameter<double>("bot/displayFps", 30.));
+  }
 }
 
 BotOp::~BotOp(){
   LOG(0) <<"shutting down BotOp...";
+  events.reset();
+  display.reset();
   if(simthread) simthread.reset();
   gripperL.reset();
   gripperR.reset();
   robotL.reset();
   robotR.reset();
+  for(Robot& r:robots) r.gripper.reset();
+  for(Robot& r:robots) r.arm.reset();
+  robots.clear();
+}
+
+void BotOp::launchRobots(rai::Configuration& C, bool useRealRobot, bool useGripper, int simLockstep){
+  //-- the robot names: bot/robots, or all arms in the configuration (sorted, i.e., 'l' before 'r' as before)
+  StringA names = rai::getParameter<StringA>("bot/robots", {});
+  if(!names.N){
+    for(rai::Frame* f:C.frames) if(f->name.endsWith("_panda_base")){
+      names.append(f->name.getFirstN(f->name.N-11));
+    }
+    std::sort(names.begin(), names.end(), [](const rai::String& a, const rai::String& b){ return strcmp(a.p, b.p)<0; });
+  }
+  for(const rai::String& name:names) robots.push_back({name, {}, {}});
+
+  if(useRealRobot){
+    //-- the robotID is the registry index: it selects Franka/ipAddresses, Robotiq/serialPorts, and the channel slot
+    if(useGripper){
+      LOG(0) <<"CONNECTING TO GRIPPERS";
+      for(uint i=0;i<robots.size();i++){
+        Robot& r = robots[i];
+        try{
+          if(C.getFrame(STRING(r.name <<"_panda_hand"), false)) r.gripper = make_shared<FrankaGripper>(i);
+          else if(C.getFrame(STRING(r.name <<"_robotiq_base"), false)) r.gripper = make_shared<RobotiqGripper>(i);
+        } catch(const std::exception& ex) {
+          LOG(-1) <<"Starting gripper '" <<r.name <<"' failed! Error msg: " <<ex.what();
+        }
+      }
+    }
+
+    LOG(0) <<"CONNECTING TO FRANKAS " <<names;
+    if(!robots.size()) LOG(0) <<"starting botop without franka robots (no frames '<name>_panda_base' defined)";
+    for(uint i=0;i<robots.size();i++){
+      Robot& r = robots[i];
+      try{
+        r.arm = make_shared<FrankaThread>(i, franka_getJointIndices(C, r.name), cmd, state, channel);
+      } catch(const std::exception& ex) {
+        LOG(-1) <<"Starting franka robot '" <<r.name <<"' failed! Error msg: " <<ex.what();
+      } catch(...) {
+        LOG(-1) <<"Starting franka robot '" <<r.name <<"' failed! Error msg: " <<rai::errString();
+      }
+    }
+    C.setJointState(get_q());
+
+    try{
+      if(C.getFrame("omnibase_world", false)){
+        LOG(0) <<"CONNECTING TO OMNIBASE";
+        robots.push_back({"omnibase", make_shared<OmnibaseThread>(robots.size(), uintA{0,1,2}, cmd, state, channel), {}});
+      }
+    } catch(const std::exception& ex) {
+      LOG(-1) <<"Starting the omnibase failed! Error msg: " <<ex.what();
+    }
+
+  }else{
+    //-- one simulation for all robots; a GripperSim for each '<name>_gripper' frame
+    simthread = make_shared<BotThreadedSim>(C, cmd, state, StringA{}, -1., -1., channel, simLockstep, (displayMode==displayHeadless ? 0 : -1));
+    if(!robots.size()) robots.push_back({"sim", {}, {}});
+    for(Robot& r:robots){
+      r.arm = simthread;
+      if(useGripper && C.getFrame(STRING(r.name <<"_gripper"), false)) r.gripper = make_shared<GripperSim>(simthread, STRING(r.name <<"_gripper"));
+    }
+    if(useGripper && !robots[0].gripper) robots[0].gripper = make_shared<GripperSim>(simthread, "l_gripper");
+  }
+
+  //-- legacy aliases
+  if(Robot* r=getRobot("l")){ robotL=r->arm; gripperL=r->gripper; }
+  if(Robot* r=getRobot("r")){ robotR=r->arm; gripperR=r->gripper; }
+  if(!robotL && !robotR && robots.size()){ robotL=robots[0].arm; gripperL=robots[0].gripper; } //sim without arms, or omnibase only
+}
+
+BotOp::Robot* BotOp::getRobot(const char* name){
+  for(Robot& r:robots) if(r.name==name) return &r;
+  return nullptr;
+}
+
+const char* BotOp::robotName(rai::ArgWord leftRight){
+  if(leftRight==rai::_left) return "l";
+  if(leftRight==rai::_right) return "r";
+  HALT("gripper side must be _left or _right");
+  return 0;
+}
+
+std::shared_ptr<rai::GripperAbstraction> BotOp::getGripper(const char* robot){
+  Robot* r = getRobot(robot);
+  if(!r && !strcmp(robot, "l")) r = getRobot("sim"); //sim without named arms: its gripper is the left one
+  if(!r || !r->gripper){ LOG(-1) <<"gripper '" <<robot <<"' disabled"; return {}; }
+  return r->gripper;
 }
 
 double BotOp::get_t(){
-  return state.get()->ctrlTime;
+  return channel->getCtrlTime();
 }
 
 void BotOp::getState(arr& q_real, arr& qDot_real, double& ctrlTime){
-  auto stateGet = state.get();
-  q_real = stateGet->q;
-  qDot_real = stateGet->qDot;
-  ctrlTime = stateGet->ctrlTime;
+  channel->getState(q_real, qDot_real, ctrlTime);
 }
 
 void BotOp::getReference(arr& q_ref, arr& qDot_ref, arr& qDDot_ref, const arr& q_real, const arr& qDot_real, double ctrlTime){
@@ -158,11 +216,44 @@ void BotOp::getReference(arr& q_ref, arr& qDot_ref, arr& qDDot_ref, const arr& q
 }
 
 arr BotOp::get_q() {
-  return state.get()->q;
+  arr q, qDot;
+  double ctrlTime;
+  channel->getState(q, qDot, ctrlTime);
+  return q;
 }
 
 arr BotOp::get_qDot() {
-  return state.get()->qDot;
+  arr q, qDot;
+  double ctrlTime;
+  channel->getState(q, qDot, ctrlTime);
+  return qDot;
+}
+
+bool BotOp::getStateAt(double ctrlTime, arr& q, arr& qDot, arr& tauExternal){
+  return channel->getStateAt(ctrlTime, q, qDot, tauExternal);
+}
+
+arr BotOp::getStateHistory(double t0, double t1){
+  arr X;
+  channel->getStateHistory(X, t0, t1);
+  return X;
+}
+
+arr BotOp::readTauExternal(CtrlChannel::TauSubscription& sub, arr& times){
+  arr tau;
+  channel->readTau(sub, times, tau);
+  return tau;
+}
+
+bool BotOp::waitForce(const std::shared_ptr<CtrlChannel::ForceMonitor>& m, double timeout){
+  CHECK(!isLockstep(), "in lockstep, step the simulation and check m->triggered instead");
+  double t0 = rai::realTime();
+  for(;;){
+    if(m->triggered.load()) return true;
+    double left = timeout - (rai::realTime()-t0);
+    if(left<=0.) return false;
+    channel->waitForTime(1e10, left); //returns on any notification, e.g., the monitor's trigger
+  }
 }
 
 double BotOp::getTimeToEnd(){
@@ -183,19 +274,18 @@ arr BotOp::getEndPoint(){
 
 arr BotOp::get_tauExternal(){
   arr tau;
-  {
-    auto stateSet = state.set();
-    tau = stateSet->tauExternalIntegral;
-    tau /= double(stateSet->tauExternalCount);
-    stateSet->tauExternalIntegral.setZero();
-    stateSet->tauExternalCount=0;
-  }
+  channel->getTauExternal(tau, tauCursor);
   return tau;
 }
 
+std::vector<rai::LoopTimingSummary> BotOp::getTimingStats(bool reset){
+  return channel->getTimingStats(reset);
+}
+
 int BotOp::sync(rai::Configuration& C, double waitTime){
-  //update q state
-  C.setJointState(state.get()->q);
+  //update q state (and the legacy state Var)
+  channel->mirrorState(state);
+  C.setJointState(get_q());
 
   //update optitrack state
   if(optitrack) optitrack->pull(C);
@@ -209,36 +299,225 @@ int BotOp::sync(rai::Configuration& C, double waitTime){
   if(simthread) simthread->pullDynamicStates(C);
 
   //gui
-  if(rai::getParameter<bool>("bot/raiseWindow",false)) C.viewer()->raiseWindow();
-  double ctrlTime = get_t();
-  keypressed = C.view(false, STRING("BotOp sync ctrl time: "<<ctrlTime <<" (=" <<int(100.*ctrlTime/(rai::realTime()-startRealTime)) <<"% real time)"));
-  if(keypressed) C.viewer()->_resetPressedKey();
+  if(raiseWindowOnSync) raiseWindow(C);
+  if(displayMode!=displayHeadless){
+    double ctrlTime = get_t();
+    rai::String title = STRING("BotOp sync ctrl time: "<<ctrlTime <<" (=" <<int(100.*ctrlTime/(rai::realTime()-startRealTime)) <<"% real time)");
+    if(displayMode==displayThread){
+      display->offer(C, title);
+      keypressed = display->takeKey();
+    }else{
+      keypressed = C.view(false, title);
+      if(keypressed) C.viewer()->_resetPressedKey();
+    }
+  }else{
+    keypressed = 0;
+  }
 //  if(keypressed==13) return false;
 //  if(keypressed=='q' || keypressed==27) return false;
 //  auto sp = std::dynamic_pointer_cast<rai::SplineCtrlReference>(ref);
 //  if(sp && ctrlTime>sp->getEndTime()) return false;
-  if(!keypressed && waitTime>0.) rai::wait(waitTime);
+  if(!keypressed && waitTime>0.){
+    if(isLockstep()) stepSim(uint(::ceil(waitTime/simthread->getTau()-1e-6)));
+    else rai::wait(waitTime);
+  }
   return keypressed;
 }
 
+bool BotOp::isLockstep(){
+  return simthread && simthread->isLockstep();
+}
+
+void BotOp::stepSim(uint steps){
+  CHECK(isLockstep(), "stepSim requires a simulation with botsim/lockstep: true");
+  simthread->stepSim(steps);
+}
+
+std::shared_ptr<const BotSimSnapshot> BotOp::simSnapshot(){
+  CHECK(simthread, "snapshots only of a simulation");
+  return simthread->snapshot();
+}
+
+void BotOp::simRestore(const std::shared_ptr<const BotSimSnapshot>& snap){
+  CHECK(simthread, "snapshots only of a simulation");
+  CHECK(snap, "");
+  simthread->restore(*snap);
+}
+
+double BotOp::runUntilEnd(double maxTime){
+  CHECK(isLockstep(), "runUntilEnd requires a simulation with botsim/lockstep: true");
+  double t0 = get_t();
+  while(getTimeToEnd()>0. && get_t()-t0<maxTime) simthread->stepSim(1);
+  return get_t()-t0;
+}
+
 int BotOp::wait(rai::Configuration& C, bool forKeyPressed, bool forTimeToEnd, bool forGripper){
-  C.viewer()->raiseWindow();
-  C.viewer()->_resetPressedKey();
+  double displayPeriod = rai::getParameter<double>("bot/waitDisplayPeriod", .1);
+  double gripperPoll = rai::getParameter<double>("bot/waitGripperPoll", .005);
+  bool lockstep = isLockstep();
+
+  raiseWindow(C);
+  if(displayMode==displaySync) C.viewer()->_resetPressedKey();
+  else if(displayMode==displayThread) display->takeKey();
+  double nextDisplay=-1.;
   for(;;){
-    sync(C, .1);
+    //-- display (and read keys) at its own rate; time is simulated time in lockstep
+    double now = (lockstep ? get_t() : rai::realTime());
+    if(now>=nextDisplay){
+      sync(C, 0.);
+      nextDisplay = now + displayPeriod;
+    }
+
     //if(keypressed=='q') return keypressed;
     if(forKeyPressed && keypressed) return keypressed;
-    if(forTimeToEnd && getTimeToEnd()<=0.) return keypressed;
-    if(forGripper && gripperDone(rai::_left)) return 'g';
-    if(!rai::getInteractivity() && !forTimeToEnd && forKeyPressed) return ' ';
+    double timeToEnd = (forTimeToEnd ? getTimeToEnd() : 1e10);
+    if(timeToEnd<=0.){ sync(C, 0.); return keypressed; } //C (and display) at the final state
+    if(forGripper && gripperDone(rai::_left)){ sync(C, 0.); return 'g'; }
+    if((!rai::getInteractivity() || displayMode==displayHeadless) && !forTimeToEnd && forKeyPressed) return ' ';
+
+    //-- block until the motion ends (woken by the control loops), or the next display/gripper poll is due
+    double timeout = nextDisplay - now;
+    if(forGripper) timeout = rai::MIN(timeout, gripperPoll);
+    timeout = rai::MIN(timeout, timeToEnd);
+    if(lockstep){
+      stepSim(rai::MAX(1u, uint(::ceil(timeout/simthread->getTau()-1e-6))));
+    }else{
+      channel->waitForTime(get_t()+timeToEnd, timeout);
+    }
   }
 }
 
-std::shared_ptr<rai::BSplineCtrlReference> BotOp::getSplineRef(){
-  auto sp = std::dynamic_pointer_cast<rai::BSplineCtrlReference>(ref);
+//===========================================================================
+
+/// serves BotOp's completion notifications (onMotionDone etc): one thread, blocking on the channel until
+/// the earliest control time a request waits for (woken by the control loops), or polling the conditions
+/// without such a time (gripper, camera frames) every bot/waitGripperPoll
+struct BotEventWatcher {
+  struct Request {
+    std::function<bool()> done;     //the event happened
+    std::function<double()> wakeTime; //control time at which done() may become true (null: poll)
+    std::promise<void> promise;
+    std::function<void()> callback;
+  };
+
+  BotOp& bot;
+  double pollPeriod;
+  std::mutex mutex;
+  std::condition_variable added;
+  std::vector<Request> pending; //under mutex
+  bool stop=false;              //under mutex
+  std::thread thread;
+
+  BotEventWatcher(BotOp& _bot)
+    : bot(_bot),
+      pollPeriod(rai::getParameter<double>("bot/waitGripperPoll", .005)),
+      thread([this](){ loop(); }) {}
+
+  ~BotEventWatcher(){
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop=true;
+    }
+    added.notify_all();
+    bot.channel->notify(); //wakes waitForTime
+    thread.join();
+    //requests still pending are dropped: their futures end with broken_promise, and their callbacks
+    //are released here (python's asyncio bridge then cancels its awaitable)
+    pending.clear();
+  }
+
+  std::shared_future<void> add(const std::function<bool()>& done, const std::function<double()>& wakeTime, const std::function<void()>& callback){
+    Request r;
+    r.done = done;
+    r.wakeTime = wakeTime;
+    r.callback = callback;
+    std::shared_future<void> f = r.promise.get_future().share();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending.push_back(std::move(r));
+    }
+    added.notify_all();
+    bot.channel->notify(); //the loop may be waiting for a later time
+    return f;
+  }
+
+  void loop(){
+    for(;;){
+      std::vector<Request> fire;
+      double wake=1e10;
+      bool poll=false;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        added.wait(lock, [this](){ return stop || !pending.empty(); });
+        if(stop) return;
+        //the conditions may change (appended or overwritten motions) -- re-check all after each wake up
+        for(size_t i=0;i<pending.size();){
+          Request& r = pending[i];
+          if(r.done()){
+            fire.push_back(std::move(r));
+            pending.erase(pending.begin()+i);
+            continue;
+          }
+          if(r.wakeTime) wake = rai::MIN(wake, r.wakeTime()); else poll=true;
+          i++;
+        }
+      }
+
+      for(Request& r:fire){
+        try{
+          if(r.callback) r.callback();
+          r.promise.set_value();
+        }catch(...){
+          r.promise.set_exception(std::current_exception());
+        }
+      }
+
+      if(fire.empty()) bot.channel->waitForTime(wake, (poll ? pollPeriod : .1));
+    }
+  }
+};
+
+std::shared_ptr<BotEventWatcher>& BotOp::eventWatcher(){
+  if(!events) events = make_shared<BotEventWatcher>(*this);
+  return events;
+}
+
+std::shared_future<void> BotOp::onMotionDone(const std::function<void()>& callback){
+  return eventWatcher()->add([this](){ return getTimeToEnd()<=0.; },
+                             [this](){ return get_t()+getTimeToEnd(); },
+                             callback);
+}
+
+std::shared_future<void> BotOp::onGripperDone(const char* robot, const std::function<void()>& callback){
+  std::shared_ptr<rai::GripperAbstraction> gripper = getGripper(robot);
+  return eventWatcher()->add([gripper](){ return !gripper || gripper->isDone(); }, {}, callback);
+}
+
+std::shared_future<void> BotOp::onNewState(const std::function<void()>& callback){
+  uint64_t rev = channel->getRevision();
+  return eventWatcher()->add([this, rev](){ return channel->getRevision()>rev; },
+                             [this](){ return get_t()+1e-6; }, //the next tick
+                             callback);
+}
+
+std::shared_future<void> BotOp::onNewFrame(const char* sensor, const std::function<void()>& callback){
+  std::shared_ptr<rai::CameraAbstraction> cam = getCamera(sensor); //(the camera list is not touched in the watcher thread)
+  uint64_t rev = cameraRevision(cam);
+  return eventWatcher()->add([this, cam, rev](){ return cameraRevision(cam)>rev; }, {}, callback);
+}
+
+uint64_t BotOp::cameraRevision(const std::shared_ptr<rai::CameraAbstraction>& cam){
+  if(std::dynamic_pointer_cast<CameraSim>(cam)) return simthread->cameraRenderer().renderCount(); //all sensors render together
+  std::shared_ptr<RealSenseThread> rs = std::dynamic_pointer_cast<RealSenseThread>(cam);
+  CHECK(rs, "no frame counter for camera '" <<cam->name <<"'");
+  return rs->image.getRevision();
+}
+
+std::shared_ptr<rai::IncrementalBSplineReference> BotOp::getSplineRef(){
+  auto sp = std::dynamic_pointer_cast<rai::IncrementalBSplineReference>(ref);
   if(!sp){
-    setReference<rai::BSplineCtrlReference>();
-    sp = std::dynamic_pointer_cast<rai::BSplineCtrlReference>(ref);
+    setReference<rai::IncrementalBSplineReference>(); //same spline, read lock-free and evaluated incrementally in the control loops
+    sp = std::dynamic_pointer_cast<rai::IncrementalBSplineReference>(ref);
     CHECK(sp, "this is not a spline reference!")
   }
   return sp;
@@ -345,8 +624,7 @@ void BotOp::moveTo(const arr& q_target, double timeCost, bool overwrite){
 }
 
 void BotOp::setControllerWriteData(int _writeData){
-  if(robotL) robotL->writeData=_writeData;
-  if(robotR) robotR->writeData=_writeData;
+  for(Robot& r:robots) if(r.arm) r.arm->writeData=_writeData;
 }
 
 void BotOp::setCompliance(const arr& J, double compliance){
@@ -370,30 +648,25 @@ void BotOp::setCompliance(const arr& J, double compliance){
   cmd.set()->P_compliance = P;
 }
 
-void BotOp::gripperMove(rai::ArgWord leftRight, double width, double speed){
-  if(leftRight==rai::_left){ if(!gripperL) LOG(-1) <<"gripper disabled"; else gripperL->open(width, speed); }
-  if(leftRight==rai::_right){ if(!gripperR) LOG(-1) <<"gripper disabled"; else gripperR->open(width, speed); }
+void BotOp::gripperMove(const char* robot, double width, double speed){
+  if(auto g=getGripper(robot)) g->open(width, speed);
 }
 
-void BotOp::gripperClose(rai::ArgWord leftRight, double force, double width, double speed){
-  if(leftRight==rai::_left){ if(!gripperL) LOG(-1) <<"gripper disabled"; else gripperL->close(force, width, speed); }
-  if(leftRight==rai::_right){ if(!gripperR) LOG(-1) <<"gripper disabled"; else gripperR->close(force, width, speed); }
+void BotOp::gripperClose(const char* robot, double force, double width, double speed){
+  if(auto g=getGripper(robot)) g->close(force, width, speed);
 }
 
-void BotOp::gripperCloseGrasp(rai::ArgWord leftRight, const char* objName, double force, double width, double speed){
-  if(leftRight==rai::_left){ if(!gripperL) LOG(-1) <<"gripper disabled"; else gripperL->closeGrasp(objName, force, width, speed); }
-  if(leftRight==rai::_right){ if(!gripperR) LOG(-1) <<"gripper disabled"; else gripperR->closeGrasp(objName, force, width, speed); }
+void BotOp::gripperCloseGrasp(const char* robot, const char* objName, double force, double width, double speed){
+  if(auto g=getGripper(robot)) g->closeGrasp(objName, force, width, speed);
 }
 
-double BotOp::getGripperPos(rai::ArgWord leftRight){
-  if(leftRight==rai::_left){ if(!gripperL) LOG(-1) <<"gripper disabled"; else return gripperL->pos(); }
-  if(leftRight==rai::_right){ if(!gripperR) LOG(-1) <<"gripper disabled"; else return gripperR->pos(); }
+double BotOp::getGripperPos(const char* robot){
+  if(auto g=getGripper(robot)) return g->pos();
   return 0;
 }
 
-bool BotOp::gripperDone(rai::ArgWord leftRight){
-  if(leftRight==rai::_left){ if(!gripperL) LOG(-1) <<"gripper disabled"; else return gripperL->isDone(); }
-  if(leftRight==rai::_right){ if(!gripperR) LOG(-1) <<"gripper disabled"; else return gripperR->isDone(); }
+bool BotOp::gripperDone(const char* robot){
+  if(auto g=getGripper(robot)) return g->isDone();
   return true;
 }
 
@@ -414,6 +687,17 @@ void BotOp::getImageAndDepth(byteA& image, floatA& depth, const char* sensor){
   cam->getImageAndDepth(image, depth);
 }
 
+double BotOp::getImagesAndDepths(rai::Array<byteA>& images, rai::Array<floatA>& depths, const StringA& sensors){
+  for(const rai::String& s:sensors) getCamera(s); //register all
+  if(simthread) return CameraSim::getImagesAndDepths(images, depths, simthread, sensors);
+
+  //real cameras: one after the other (no common timestamp)
+  images.resize(sensors.N);
+  depths.resize(sensors.N);
+  for(uint i=0;i<sensors.N;i++) getCamera(sensors(i))->getImageAndDepth(images(i), depths(i));
+  return -1.;
+}
+
 arr BotOp::getCameraFxycxy(const char* sensor){
   auto cam = getCamera(sensor);
   return cam->getFxycxy();
@@ -429,14 +713,19 @@ void BotOp::getImageDepthPcl(byteA& image, floatA& depth, arr& points, const cha
   }
 }
 
+void BotOp::raiseWindow(rai::Configuration& C){
+  if(displayMode==displaySync) C.viewer()->raiseWindow();
+  else if(displayMode==displayThread) display->raiseWindow();
+}
+
 void BotOp::home(rai::Configuration& C){
-  C.viewer()->raiseWindow();
+  raiseWindow(C);
   moveTo(qHome, 1., true);
   wait(C);
 }
 
 void BotOp::stop(rai::Configuration& C){
-  C.viewer()->raiseWindow();
+  raiseWindow(C);
   moveTo(get_q(), .01, true);
   wait(C);
 }
@@ -470,22 +759,52 @@ void BotOp::sound(int noteRelToC, float a, float decay){
 
 //===========================================================================
 
+ZeroReference& ZeroReference::setVelocityReference(const arr& _velocity_ref){
+  std::lock_guard<std::mutex> lock(publishMutex);
+  next.velocity = _velocity_ref;
+  publish();
+  return *this;
+}
+
+ZeroReference& ZeroReference::setPositionReference(const arr& _position_ref){
+  std::lock_guard<std::mutex> lock(publishMutex);
+  next.position = _position_ref;
+  publish();
+  return *this;
+}
+
+void ZeroReference::publish(){
+  refs.publish(new Refs(next));
+}
+
 void ZeroReference::getReference(arr& q_ref, arr& qDot_ref, arr& qDDot_ref, const arr& q_real, const arr& qDot_real, double ctrlTime){
-  {
-    arr pos = position_ref.get()();
-    if(pos.N) q_ref = pos;
-    else q_ref.clear(); // = q_real;  //->no position gains at all
-  }
-  {
-    arr vel = velocity_ref.get()();
-    if(vel.N==1){
-      double a = vel.scalar();
+  //called within the (allocation-free) control loop: write into the caller's buffers in place;
+  //'no reference' is N=0 via resize(0), which keeps their capacity (unlike clear())
+  auto write = [&](const Refs* R){
+    const arr* pos = R ? &R->position : 0;
+    const arr* vel = R ? &R->velocity : 0;
+
+    if(pos && pos->N){ q_ref.resize(pos->N); memmove(q_ref.p, pos->p, pos->N*sizeof(double)); }
+    else q_ref.resize(0); // = q_real;  //->no position gains at all
+
+    if(vel && vel->N==1){
+      double a = vel->elem(0);
       CHECK(a>=0. && a<=1., "");
-      qDot_ref = a * qDot_real; //[0] -> zero vel reference -> damping
+      qDot_ref.resize(qDot_real.N); //[0] -> zero vel reference -> damping
+      for(uint i=0;i<qDot_real.N;i++) qDot_ref.p[i] = a * qDot_real.p[i];
     }
-    else if(vel.N) qDot_ref = vel;
-    else qDot_ref.clear(); //.clear();  //[] -> no damping at all! (and also no friction compensation based on reference qDot)
+    else if(vel && vel->N){ qDot_ref.resize(vel->N); memmove(qDot_ref.p, vel->p, vel->N*sizeof(double)); }
+    else qDot_ref.resize(0);  //[] -> no damping at all! (and also no friction compensation based on reference qDot)
+  };
+
+  int r = readers.get();
+  if(r>=0){
+    write(refs.acquire(r));
+    refs.release(r);
+  }else{ //more reading threads than slots: read the setters' copy under their lock
+    std::lock_guard<std::mutex> lock(publishMutex);
+    write(&next);
   }
-  qDDot_ref.clear(); //[] -> no acc at all
+  qDDot_ref.resize(0); //[] -> no acc at all
 }
 
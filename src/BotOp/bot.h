@@ -2,6 +2,10 @@
 
 #include <Kin/kin.h>
 #include <Control/CtrlMsgs.h>
+#include <RealTime/ctrlChannel.h>
+
+#include <functional>
+#include <future>
 
 //fwd declarations
 namespace rai{
@@ -9,19 +13,32 @@ namespace rai{
   struct OptiTrack;
   struct ViveController;
   struct Sound;
+  struct IncrementalBSplineReference;
 }
 struct BotThreadedSim;
+struct BotSimSnapshot;
+struct BotEventWatcher;
+struct BotDisplay;
 
 //===========================================================================
 
 struct BotOp{
   Var<rai::CtrlCmdMsg> cmd;
-  Var<rai::CtrlStateMsg> state;
+  Var<rai::CtrlStateMsg> state; //mirrored from the channel on sync() -- read the channel for fresh state
+  std::shared_ptr<CtrlChannel> channel; //lock-free state/cmd exchange with the robot threads
   //since each of the following interfaces is already pimpl, we don't have to hide them again
-  std::shared_ptr<rai::RobotAbstraction> robotL;
-  std::shared_ptr<rai::RobotAbstraction> robotR;
-  std::shared_ptr<rai::GripperAbstraction> gripperL;
-  std::shared_ptr<rai::GripperAbstraction> gripperR;
+
+  //the robot registry: one entry per arm/base (its frame prefix, e.g. 'l', 'r', 'omnibase'), in robotID order --
+  //from bot/robots, or all '<prefix>_panda_base' frames of the configuration; each robot thread publishes into
+  //its own lock-free slice (its qIndices) of the channel
+  struct Robot{
+    rai::String name;
+    std::shared_ptr<rai::RobotAbstraction> arm;
+    std::shared_ptr<rai::GripperAbstraction> gripper;
+  };
+  std::vector<Robot> robots;
+  std::shared_ptr<rai::RobotAbstraction> robotL, robotR; //legacy: the arms of robots 'l' and 'r' (sim: the simulation)
+  std::shared_ptr<rai::GripperAbstraction> gripperL, gripperR; //legacy: the grippers of robots 'l' and 'r'
   std::shared_ptr<rai::ReferenceFeed> ref;
   std::shared_ptr<rai::OptiTrack> optitrack;
   std::shared_ptr<rai::ViveController> vivecontroller;
@@ -32,7 +49,14 @@ struct BotOp{
   arr qHome;
   int keypressed=0;
 
-  BotOp(rai::Configuration& C, bool useRealRobot);
+  //display of the user's configuration (bot/display): rendered in sync() on the calling thread,
+  //in a display thread at most bot/displayFps from pose snapshots, or not at all
+  enum DisplayMode { displaySync=0, displayThread, displayHeadless };
+  DisplayMode displayMode=displaySync;
+  std::shared_ptr<BotDisplay> display;
+
+  //simLockstep -1: from botsim/lockstep; _display -1: from bot/display, else a DisplayMode (headless also keeps the sim's own display closed)
+  BotOp(rai::Configuration& C, bool useRealRobot, int simLockstep=-1, int _display=-1);
   ~BotOp();
 
   //-- state info
@@ -46,6 +70,22 @@ struct BotOp{
   arr getEndPoint(); //negative, if motion spline is done
   arr get_tauExternal();
   int getKeyPressed(){ return keypressed; }
+  std::vector<rai::LoopTimingSummary> getTimingStats(bool reset=false); //latency percentiles of all robot control loops
+
+  //-- state history (the last bot/stateHistory seconds, recorded by the control loops), e.g., the state at a camera's capture time
+  bool getStateAt(double ctrlTime, arr& q, arr& qDot, arr& tauExternal=NoArr); //interpolated; false if ctrlTime is not covered
+  arr getStateHistory(double t0, double t1); //one row [time, q, qDot, tauExternal] per control tick in [t0,t1]
+
+  //-- external torque streaming: every control tick's tauExternal sample (e.g. libfranka's tau_ext_hat_filtered),
+  //   to any number of subscribers, each with its own cursor (unlike get_tauExternal, which averages for one consumer)
+  CtrlChannel::TauSubscription subscribeTauExternal(){ return channel->subscribeTau(); }
+  arr readTauExternal(CtrlChannel::TauSubscription& sub, arr& times=NoArr); //one row per sample since the last read
+
+  //-- force thresholds, checked in the control loop at every tick: |(J J^T)^-1 J tauExternal| > threshold
+  //   (J: task Jacobian, e.g. of an end effector, depending on the joints of one robot only)
+  std::shared_ptr<CtrlChannel::ForceMonitor> addForceMonitor(const arr& J, double threshold){ return channel->addForceMonitor(J, threshold); }
+  void removeForceMonitor(const std::shared_ptr<CtrlChannel::ForceMonitor>& m){ channel->removeForceMonitor(m); }
+  bool waitForce(const std::shared_ptr<CtrlChannel::ForceMonitor>& m, double timeout); //true if triggered (woken by the control loop)
 
   //-- motion commands
   void move(const arr& path, const arr& times, bool overwrite=false, double overwriteCtrlTime=-1.);
@@ -55,22 +95,48 @@ struct BotOp{
   void setControllerWriteData(int _writeData);
   void setCompliance(const arr& J, double compliance=.5);
 
-  //-- gripper commands - directly calling the gripper abstraction
-  void gripperMove(rai::ArgWord leftRight, double width=.075, double speed=.2);
-  void gripperClose(rai::ArgWord leftRight, double force=10, double width=.05, double speed=.1);
-  void gripperCloseGrasp(rai::ArgWord leftRight, const char* objName, double force=10, double width=.05, double speed=.1);
-  double getGripperPos(rai::ArgWord leftRight);
-  bool gripperDone(rai::ArgWord leftRight);
+  //-- gripper commands - directly calling the gripper abstraction of a robot (by name; _left/_right: robots 'l'/'r')
+  void gripperMove(const char* robot, double width=.075, double speed=.2);
+  void gripperClose(const char* robot, double force=10, double width=.05, double speed=.1);
+  void gripperCloseGrasp(const char* robot, const char* objName, double force=10, double width=.05, double speed=.1);
+  double getGripperPos(const char* robot);
+  bool gripperDone(const char* robot);
+  void gripperMove(rai::ArgWord leftRight, double width=.075, double speed=.2){ gripperMove(robotName(leftRight), width, speed); }
+  void gripperClose(rai::ArgWord leftRight, double force=10, double width=.05, double speed=.1){ gripperClose(robotName(leftRight), force, width, speed); }
+  void gripperCloseGrasp(rai::ArgWord leftRight, const char* objName, double force=10, double width=.05, double speed=.1){ gripperCloseGrasp(robotName(leftRight), objName, force, width, speed); }
+  double getGripperPos(rai::ArgWord leftRight){ return getGripperPos(robotName(leftRight)); }
+  bool gripperDone(rai::ArgWord leftRight){ return gripperDone(robotName(leftRight)); }
 
   //-- camera commands
   void getImageAndDepth(byteA& image, floatA& depth, const char* sensor);
+  double getImagesAndDepths(rai::Array<byteA>& images, rai::Array<floatA>& depths, const StringA& sensors); //sim: one render batch, common timestamp (returned)
   void getImageDepthPcl(byteA& image, floatA& depth, arr& points, const char* sensor, bool globalCoordinates=false);
   arr  getCameraFxycxy(const char* sensor);
 
   //-- sync the user's C with the robot, update the display, return pressed key
+  //   (lockstep simulation: waitTime advances simulated time instead of sleeping)
   int sync(rai::Configuration& C, double waitTime=.1);
+  //   wait blocks until the motion ends (signaled by the control loops), the gripper is done or a key is pressed;
+  //   the display refreshes (and keys are read) every bot/waitDisplayPeriod, the gripper is polled every bot/waitGripperPoll
   int wait(rai::Configuration& C, bool forKeyPressed=true, bool forTimeToEnd=true, bool forGripper=false);
 
+  //-- completion notifications: the future becomes ready (and the callback is called, in a BotOp-owned thread)
+  //   once the event happened -- the basis of the asyncio interface in python
+  std::shared_future<void> onMotionDone(const std::function<void()>& callback={}); //the motion spline ended (with a move appended before, the end of that)
+  std::shared_future<void> onGripperDone(const char* robot, const std::function<void()>& callback={});
+  std::shared_future<void> onGripperDone(rai::ArgWord leftRight, const std::function<void()>& callback={}){ return onGripperDone(robotName(leftRight), callback); }
+  std::shared_future<void> onNewState(const std::function<void()>& callback={}); //the next state publication of any robot
+  std::shared_future<void> onNewFrame(const char* sensor, const std::function<void()>& callback={}); //the next image of the camera
+
+  //-- lockstep simulation (botsim/lockstep: true): time advances only on these calls, at CPU speed
+  bool isLockstep();
+  void stepSim(uint steps=1);  //advance by steps control cycles (of botsim/tau)
+  double runUntilEnd(double maxTime=60.); //step until the motion ended (getTimeToEnd<=0); returns the simulated time advanced
+
+  //-- simulation snapshots: branch 'what if' rollouts from a common state (then set a new motion)
+  std::shared_ptr<const BotSimSnapshot> simSnapshot();
+  void simRestore(const std::shared_ptr<const BotSimSnapshot>& snap);
+
   //-- motion macros
   void home(rai::Configuration& C);
   void stop(rai::Configuration& C);
@@ -79,24 +145,44 @@ struct BotOp{
   //-- audio
   void sound(int noteRelToC=0, float a=.5, float decay=0.0007);
 
+  //-- robot registry
+  Robot* getRobot(const char* name); //nullptr if there is no such robot
+
 private:
+  static const char* robotName(rai::ArgWord leftRight);
+  std::shared_ptr<rai::GripperAbstraction> getGripper(const char* robot); //logs if disabled
+  void launchRobots(rai::Configuration& C, bool useRealRobot, bool useGripper, int simLockstep);
   std::shared_ptr<rai::CameraAbstraction>& getCamera(const char* sensor);
   template<class T> BotOp& setReference();
-  std::shared_ptr<rai::BSplineCtrlReference> getSplineRef();
+  std::shared_ptr<rai::IncrementalBSplineReference> getSplineRef();
   double startRealTime;
+  CtrlChannel::TauCursor tauCursor;
+  std::shared_ptr<BotEventWatcher> events; //created on the first on...() notification
+  std::shared_ptr<BotEventWatcher>& eventWatcher();
+  uint64_t cameraRevision(const std::shared_ptr<rai::CameraAbstraction>& cam);
+  bool raiseWindowOnSync=false; //bot/raiseWindow
+  void raiseWindow(rai::Configuration& C);
 };
 
 //===========================================================================
 
 struct ZeroReference : rai::ReferenceFeed {
-  Var<arr> position_ref; ///< if set, defines a non-zero velocity reference
-  Var<arr> velocity_ref; ///< if set, defines a non-zero velocity reference
+  enum { maxReaders=8 };
 
-  ZeroReference& setVelocityReference(const arr& _velocity_ref){ velocity_ref.set() = _velocity_ref; return *this; }
-  ZeroReference& setPositionReference(const arr& _position_ref){ position_ref.set() = _position_ref; return *this; }
+  ZeroReference& setVelocityReference(const arr& _velocity_ref); ///< if set, defines a non-zero velocity reference
+  ZeroReference& setPositionReference(const arr& _position_ref); ///< if set, defines a position reference
 
-  /// callback called by a robot control loop
+  /// callback called by a robot control loop -- reads the latest published references without locking
+  /// (a thread beyond the first maxReaders falls back to reading them under publishMutex)
   virtual void getReference(arr& q_ref, arr& qDot_ref, arr& qDDot_ref, const arr& q_real, const arr& qDot_real, double ctrlTime);
+
+private:
+  struct Refs { arr position, velocity; }; //immutable once published
+  Refs next; //the user side's current references
+  std::mutex publishMutex; //serializes the setters (readers only take it in the fallback)
+  rai::RcuPointer<Refs, maxReaders> refs;
+  rai::ThreadSlots<maxReaders> readers; //one hazard slot per calling thread
+  void publish();
 };
 
 //===========================================================================
@@ -0,0 +1,60 @@
+#include "display.h"
+
+#include <Kin/viewer.h>
+
+//===========================================================================
+
+BotDisplay::BotDisplay(const rai::Configuration& C, double fps)
+  : Thread("BotDisplay", 1./fps){
+  displayC.copy(C);
+  nFrames = C.frames.N;
+  snapshotX = C.getFrameState();
+  snapshotTitle = "BotOp associated Configuration";
+  snapshotHas = true;
+  threadLoop();
+}
+
+BotDisplay::~BotDisplay(){
+  threadClose();
+}
+
+void BotDisplay::offer(const rai::Configuration& C, const char* title){
+  std::shared_ptr<rai::Configuration> newC;
+  if(C.frames.N!=nFrames){ //frames added or removed: the display needs a new copy (rare)
+    newC = make_shared<rai::Configuration>();
+    newC->copy(C);
+    nFrames = C.frames.N;
+  }
+  arr X = C.getFrameState();
+
+  std::lock_guard<std::mutex> lock(snapshotMutex);
+  snapshotX = X;
+  snapshotTitle = title;
+  snapshotHas = true;
+  if(newC) snapshotConfig = newC;
+}
+
+void BotDisplay::step(){
+  rai::String title;
+  {
+    std::lock_guard<std::mutex> lock(snapshotMutex);
+    if(snapshotConfig){
+      displayC.clear();
+      displayC.copy(*snapshotConfig);
+      snapshotConfig.reset();
+    }
+    if(snapshotHas){
+      if(snapshotX.d0==displayC.frames.N) displayC.setFrameState(snapshotX);
+      snapshotHas = false;
+    }
+    title = snapshotTitle;
+  }
+
+  //render every cycle (also without new poses), so that key presses are picked up
+  if(raise.exchange(false)) displayC.viewer()->raiseWindow();
+  int k = displayC.view(false, title);
+  if(k){
+    key = k;
+    displayC.viewer()->_resetPressedKey();
+  }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Core/thread.h>
+#include <Kin/kin.h>
+
+#include <mutex>
+
+//===========================================================================
+//
+// display of BotOp's configuration in its own thread (bot/display: thread)
+//
+// sync() only hands over a snapshot of the frame poses (and the title); the display thread
+// renders the latest one at most bot/displayFps times per second, on its own copy of the
+// configuration. If frames were added or removed, the configuration is copied anew. Keys
+// pressed in the window are collected for the user side (takeKey).
+//
+
+struct BotDisplay : Thread {
+  BotDisplay(const rai::Configuration& C, double fps);
+  ~BotDisplay();
+
+  /// user side: hand over the current poses and the title (cheap: a copy of the frame state)
+  void offer(const rai::Configuration& C, const char* title);
+
+  /// key pressed since the last call (0: none)
+  int takeKey(){ return key.exchange(0); }
+
+  /// raise the window (at the next display cycle)
+  void raiseWindow(){ raise=true; }
+
+private:
+  rai::Configuration displayC;
+  uint nFrames; //frame count of the user's configuration at the last copy (user side only)
+
+  std::mutex snapshotMutex;
+  arr snapshotX;
+  rai::String snapshotTitle;
+  bool snapshotHas=false;
+  std::shared_ptr<rai::Configuration> snapshotConfig; //a new copy, if the frame set changed
+
+  std::atomic<int> key={0};
+  std::atomic<bool> raise={false};
+
+  void step();
+};
@@ -13,9 +13,63 @@
 #include <ry/types.h>
 
 #include "bot.h"
+#include "simulation.h"
 
 #include <KOMO/pathTools.h>
 
+/// numpy array viewing the buffer of a rai array, without copying: the numpy array keeps owner
+/// (whatever holds x) alive until its last reference is gone
+template<class T> pybind11::array_t<T> Array2numpy_shared(const rai::Array<T>& x, const std::shared_ptr<void>& owner){
+  pybind11::capsule base(new std::shared_ptr<void>(owner), [](void* p){ delete reinterpret_cast<std::shared_ptr<void>*>(p); });
+  CHECK_LE(x.nd, 3, "");
+  std::vector<pybind11::ssize_t> shape;
+  if(x.nd==0) shape.push_back(0);
+  if(x.nd>=1) shape.push_back(x.d0);
+  if(x.nd>=2) shape.push_back(x.d1);
+  if(x.nd>=3) shape.push_back(x.d2);
+  return pybind11::array_t<T>(shape, x.p, base);
+}
+
+typedef pybind11::call_guard<pybind11::gil_scoped_release> ReleaseGIL; //for blocking calls: other python threads run meanwhile
+
+/// an asyncio future of the running event loop, and a callback (for any C++ thread) that resolves it in
+/// the loop's thread -- the bridge from BotOp's on...() notifications to awaitables. If the callback is
+/// dropped without having been called (BotOp shut down with the request pending), the future is cancelled
+std::pair<pybind11::object, std::function<void()>> asyncioFuture(){
+  struct State {
+    pybind11::object loop, future;
+    bool resolved=false;
+    /// resolve or cancel the future in the loop's thread, unless it is done (e.g. cancelled by the user)
+    void schedule(bool cancel){
+      pybind11::object fut = future;
+      try{
+        loop.attr("call_soon_threadsafe")(pybind11::cpp_function([fut, cancel](){
+          if(fut.attr("done")().cast<bool>()) return;
+          if(cancel) fut.attr("cancel")();
+          else fut.attr("set_result")(pybind11::none());
+        }));
+      }catch(pybind11::error_already_set& err){ //loop closed meanwhile
+        err.discard_as_unraisable(__func__);
+      }
+    }
+  };
+  pybind11::object loop = pybind11::module::import("asyncio").attr("get_running_loop")();
+  pybind11::object future = loop.attr("create_future")();
+  //the python objects are touched (in whichever thread) only under the GIL
+  std::shared_ptr<State> state(new State{loop, future},
+                               [](State* s){
+                                 pybind11::gil_scoped_acquire gil;
+                                 if(!s->resolved) s->schedule(true);
+                                 delete s;
+                               });
+  std::function<void()> resolve = [state](){
+    pybind11::gil_scoped_acquire gil;
+    state->resolved = true;
+    state->schedule(false);
+  };
+  return {future, resolve};
+}
+
 //PYBIND11_MODULE(libpybot, m) {
 //  m.doc() = "bot bindings";
 
@@ -23,10 +77,31 @@
 //}
 
 void init_BotOp(pybind11::module& m) {
-  
+
+  pybind11::class_<BotSimSnapshot, std::shared_ptr<BotSimSnapshot>>(m, "BotSimSnapshot", "state of a BotOp simulation, see BotOp.simSnapshot")
+  .def_readonly("ctrlTime", &BotSimSnapshot::ctrlTime)
+  ;
+
+  pybind11::class_<CtrlChannel::TauSubscription, std::shared_ptr<CtrlChannel::TauSubscription>>(m, "TauSubscription", "a subscriber's cursor into the stream of tauExternal samples, see BotOp.subscribeTauExternal")
+  .def_readonly("dropped", &CtrlChannel::TauSubscription::dropped)
+  ;
+
+  pybind11::class_<CtrlChannel::ForceMonitor, std::shared_ptr<CtrlChannel::ForceMonitor>>(m, "ForceMonitor", "task-space force threshold checked in the control loop, see BotOp.addForceMonitor")
+  .def_property_readonly("triggered", [](CtrlChannel::ForceMonitor& self){ return self.triggered.load(); })
+  .def_property_readonly("triggerTime", [](CtrlChannel::ForceMonitor& self){ return self.triggerTime.load(); })
+  .def_property_readonly("force", [](CtrlChannel::ForceMonitor& self){ return self.force.load(); })
+  .def("reset", &CtrlChannel::ForceMonitor::reset)
+  ;
+
   pybind11::class_<BotOp, shared_ptr<BotOp>>(m, "BotOp", "Robot Operation interface -- see https://marctoussaint.github.io/robotics-course/tutorials/1b-botop.html")
 
-  .def(pybind11::init<rai::Configuration&, bool>(),
+  //the holder deletes BotOp with the GIL released: its threads (e.g. the event watcher resolving an
+  //awaitable) may need the GIL to finish while the destructor joins them
+  .def(pybind11::init([](rai::Configuration& C, bool useRealRobot){
+      return std::shared_ptr<BotOp>(new BotOp(C, useRealRobot), [](BotOp* bot){
+        if(PyGILState_Check()){ pybind11::gil_scoped_release release; delete bot; }
+        else delete bot;
+      }); }),
        "constructor",
        pybind11::arg("C"),
        pybind11::arg("useRealRobot")
@@ -47,6 +122,82 @@ void init_BotOp(pybind11::module& m) {
   .def("get_tauExternal", &BotOp::get_tauExternal,
        "get the current (real) robot joint torques (external: gravity & acceleration removed) -- each call averages from last call; first call might return nonsense!")
 
+  .def("getStateAt", [](BotOp& self, double ctrlTime){
+      arr q, qDot, tauExternal;
+      bool covered = self.getStateAt(ctrlTime, q, qDot, tauExternal);
+      return pybind11::make_tuple(q, qDot, tauExternal, covered); },
+       "returns (q, qDot, tauExternal, covered): the robot state at a past control time (e.g., the capture time of an image), "
+       "linearly interpolated in the state history kept by the control loops (the last bot/stateHistory seconds); covered is false if the time is outside the history",
+       pybind11::arg("ctrlTime"))
+
+  .def("getStateHistory", [](BotOp& self, double t0, double t1){
+      auto X = make_shared<arr>();
+      self.channel->getStateHistory(*X, t0, t1);
+      return Array2numpy_shared<double>(*X, X); },
+       "returns an array with one row [time, q, qDot, tauExternal] per control tick within [t0, t1] (from the state history)",
+       pybind11::arg("t0"),
+       pybind11::arg("t1"))
+
+  .def("subscribeTauExternal", [](BotOp& self){ return make_shared<CtrlChannel::TauSubscription>(self.subscribeTauExternal()); },
+       "returns a subscription to the stream of tauExternal samples (one per control tick, from now on) -- any number of subscribers can read independently")
+
+  .def("readTauExternal", [](BotOp& self, std::shared_ptr<CtrlChannel::TauSubscription>& sub){
+      auto tau = make_shared<arr>();
+      auto times = make_shared<arr>();
+      self.channel->readTau(*sub, *times, *tau);
+      return pybind11::make_tuple(Array2numpy_shared<double>(*tau, tau), Array2numpy_shared<double>(*times, times)); },
+       "returns (tau, times): all tauExternal samples since the last read with this subscription (one row per control tick) and their control times; "
+       "samples lost because of reading too rarely (beyond bot/stateHistory) are counted in sub.dropped",
+       pybind11::arg("subscription"))
+
+  .def("addForceMonitor", &BotOp::addForceMonitor,
+       "adds a force threshold, checked in the control loop at every tick: triggers when |(J J^T)^-1 J tauExternal| > threshold, "
+       "with J a task Jacobian (e.g., of the end effector) depending on the joints of one robot only",
+       pybind11::arg("J"),
+       pybind11::arg("threshold"))
+
+  .def("removeForceMonitor", &BotOp::removeForceMonitor,
+       "removes a force monitor",
+       pybind11::arg("monitor"))
+
+  .def("waitForce", &BotOp::waitForce, ReleaseGIL(),
+       "blocks until the force monitor triggers (returns True) or the timeout [sec] passed (False)",
+       pybind11::arg("monitor"),
+       pybind11::arg("timeout"))
+
+  .def("motionDoneAsync", [](std::shared_ptr<BotOp>& self){
+      auto f = asyncioFuture();
+      self->onMotionDone(f.second);
+      return f.first; },
+       "awaitable (asyncio, call within the running loop): done when the motion spline ended -- woken by the control loop, no polling")
+
+  .def("gripperDoneAsync", [](std::shared_ptr<BotOp>& self, rai::ArgWord leftRight){
+      auto f = asyncioFuture();
+      self->onGripperDone(leftRight, f.second);
+      return f.first; },
+       "awaitable (asyncio): done when the gripper is done (polled every bot/waitGripperPoll in a BotOp thread)",
+       pybind11::arg("leftRight"))
+
+  .def("gripperDoneAsync", [](std::shared_ptr<BotOp>& self, const char* robot){
+      auto f = asyncioFuture();
+      self->onGripperDone(robot, f.second);
+      return f.first; },
+       "awaitable (asyncio): done when the gripper of the named robot is done",
+       pybind11::arg("robot"))
+
+  .def("newStateAsync", [](std::shared_ptr<BotOp>& self){
+      auto f = asyncioFuture();
+      self->onNewState(f.second);
+      return f.first; },
+       "awaitable (asyncio): done with the next state publication of the control loops")
+
+  .def("newFrameAsync", [](std::shared_ptr<BotOp>& self, const char* sensorName){
+      auto f = asyncioFuture();
+      self->onNewFrame(sensorName, f.second);
+      return f.first; },
+       "awaitable (asyncio): done when the camera has a new image (then read it with getImageAndDepth)",
+       pybind11::arg("sensorName"))
+
   .def("getTimeToEnd", &BotOp::getTimeToEnd,
        "get time-to-go of the current spline reference that is tracked (use getTimeToEnd()<=0. to check if motion execution is done)")
 
@@ -64,13 +215,13 @@ void init_BotOp(pybind11::module& m) {
        pybind11::arg("overwrite") = false,
        pybind11::arg("overwriteCtrlTime") = -1.)
 
-  .def("moveAutoTimed", &BotOp::moveAutoTimed,
+  .def("moveAutoTimed", &BotOp::moveAutoTimed, ReleaseGIL(),
        "helper to execute a path (typically fine resolution, from KOMO or RRT) with equal time spacing chosen for given max vel/acc",
        pybind11::arg("path"),
        pybind11::arg("maxVel") =  1.,
        pybind11::arg("maxAcc") =  1.)
 
-  .def("moveTo", &BotOp::moveTo,
+  .def("moveTo", &BotOp::moveTo, ReleaseGIL(),
        "helper to move to a single joint vector target, where timing is chosen optimally based on the given timing cost"
        "\n\nWhen using overwrite, this immediately steers to the target -- use this as a well-timed reactive q_target controller",
        pybind11::arg("q_target"),
@@ -82,23 +233,63 @@ void init_BotOp(pybind11::module& m) {
        pybind11::arg("J"),
        pybind11::arg("compliance") = .5)
 
+  .def("getTimingStats", [](BotOp& self, bool reset){
+    auto latency = [](const rai::LatencySummary& x){
+      pybind11::dict d;
+      d["count"] = x.count;  d["mean"] = x.mean;  d["max"] = x.max;
+      d["p50"] = x.p50;  d["p90"] = x.p90;  d["p99"] = x.p99;  d["p99.9"] = x.p999;
+      return d;
+    };
+    pybind11::dict stats;
+    for(const rai::LoopTimingSummary& s:self.getTimingStats(reset)){
+      pybind11::dict d;
+      d["nominalPeriod"] = s.nominalPeriod;
+      d["overruns"] = s.overruns;
+      d["stalls"] = s.stalls;
+      d["duration"] = latency(s.duration);
+      d["period"] = latency(s.period);
+      d["reference"] = latency(s.reference);
+      d["lockWait"] = latency(s.lockWait);
+      d["dynamics"] = latency(s.dynamics);
+      d["dynamicsSkipped"] = s.dynamicsSkipped;
+      d["dynamicsSavedPerTick"] = s.dynamicsSavedPerTick;
+      stats[s.name.p] = d;
+    }
+    return stats;
+  },
+       "latency statistics (in seconds) of each robot control loop: callback duration, start-to-start period, reference evaluation, and state/cmd exchange (lockWait) -- each with count, mean, p50, p90, p99, p99.9, max; overruns counts ticks longer than the nominal period, stalls the ticks with too large tracking error; dynamics: single model evaluations, with the number skipped by lazy evaluation and the estimated time saved per tick",
+       pybind11::arg("reset") = false)
+
   .def("setControllerWriteData", &BotOp::setControllerWriteData,
        "[for internal debugging only] triggers writing control data into a file")
 
-  .def("gripperMove", &BotOp::gripperMove,
+  .def("gripperMove", pybind11::overload_cast<rai::ArgWord, double, double>(&BotOp::gripperMove), ReleaseGIL(),
        "move the gripper to width (default: open)",
       pybind11::arg("leftRight"),
       pybind11::arg("width") = .075,
       pybind11::arg("speed") = .2)
 
-  .def("gripperClose", &BotOp::gripperClose,
+  .def("gripperMove", pybind11::overload_cast<const char*, double, double>(&BotOp::gripperMove), ReleaseGIL(),
+       "move the gripper of the named robot (see robotNames) to width (default: open)",
+      pybind11::arg("robot"),
+      pybind11::arg("width") = .075,
+      pybind11::arg("speed") = .2)
+
+  .def("gripperClose", pybind11::overload_cast<rai::ArgWord, double, double, double>(&BotOp::gripperClose), ReleaseGIL(),
        "close gripper",
        pybind11::arg("leftRight"),
        pybind11::arg("force") = 10.,
        pybind11::arg("width") = .05,
        pybind11::arg("speed") = .1)
 
-  .def("gripperCloseGrasp", &BotOp::gripperCloseGrasp,
+  .def("gripperClose", pybind11::overload_cast<const char*, double, double, double>(&BotOp::gripperClose), ReleaseGIL(),
+       "close the gripper of the named robot",
+       pybind11::arg("robot"),
+       pybind11::arg("force") = 10.,
+       pybind11::arg("width") = .05,
+       pybind11::arg("speed") = .1)
+
+  .def("gripperCloseGrasp", pybind11::overload_cast<rai::ArgWord, const char*, double, double, double>(&BotOp::gripperCloseGrasp), ReleaseGIL(),
         "close gripper and indicate what should be grasped -- makes no difference in real, but helps simulation to mimic grasping more reliably",
         pybind11::arg("leftRight"),
         pybind11::arg("objName"),
@@ -106,56 +297,121 @@ void init_BotOp(pybind11::module& m) {
         pybind11::arg("width") = .05,
         pybind11::arg("speed") = .1)
 
-  .def("getGripperPos", &BotOp::getGripperPos,
+  .def("gripperCloseGrasp", pybind11::overload_cast<const char*, const char*, double, double, double>(&BotOp::gripperCloseGrasp), ReleaseGIL(),
+        "close the gripper of the named robot and indicate what should be grasped",
+        pybind11::arg("robot"),
+        pybind11::arg("objName"),
+        pybind11::arg("force") = 10.,
+        pybind11::arg("width") = .05,
+        pybind11::arg("speed") = .1)
+
+  .def("getGripperPos", pybind11::overload_cast<rai::ArgWord>(&BotOp::getGripperPos),
        "returns the gripper pos",
        pybind11::arg("leftRight"))
 
-  .def("gripperDone", &BotOp::gripperDone,
+  .def("getGripperPos", pybind11::overload_cast<const char*>(&BotOp::getGripperPos),
+       "returns the gripper pos of the named robot",
+       pybind11::arg("robot"))
+
+  .def("gripperDone", pybind11::overload_cast<rai::ArgWord>(&BotOp::gripperDone),
        "returns if gripper is done",
        pybind11::arg("leftRight"))
 
+  .def("gripperDone", pybind11::overload_cast<const char*>(&BotOp::gripperDone),
+       "returns if the gripper of the named robot is done",
+       pybind11::arg("robot"))
+
+  .def("robotNames", [](std::shared_ptr<BotOp>& self){
+      std::vector<std::string> names;
+      for(const BotOp::Robot& r:self->robots) names.push_back(r.name.p);
+      return names; },
+       "the names of the registered robots (bot/robots, or the '<name>_panda_base' frames), in robotID order")
+
   .def("getCameraFxycxy", &BotOp::getCameraFxycxy,
        "returns camera intrinsics",
        pybind11::arg("sensorName"))
 
   .def("getImageAndDepth",  [](std::shared_ptr<BotOp>& self, const char* sensorName) {
-      byteA img;
-      floatA depth;
-      self->getImageAndDepth(img, depth, sensorName);
-      return pybind11::make_tuple(Array2numpy<byte>(img),
-                                  Array2numpy<float>(depth)); },
-       "returns image and depth from a camera sensor",
+      auto img = make_shared<byteA>();
+      auto depth = make_shared<floatA>();
+      {
+        pybind11::gil_scoped_release release;
+        self->getImageAndDepth(*img, *depth, sensorName);
+      }
+      return pybind11::make_tuple(Array2numpy_shared<byte>(*img, img),
+                                  Array2numpy_shared<float>(*depth, depth)); },
+       "returns image and depth from a camera sensor (numpy arrays sharing the C++ buffers, no copy)",
        pybind11::arg("sensorName"))
 
+  .def("getImagesAndDepths",  [](std::shared_ptr<BotOp>& self, const std::vector<std::string>& sensorNames) {
+      StringA sensors;
+      for(const std::string& s:sensorNames) sensors.append(rai::String(s));
+      auto imgs = make_shared<rai::Array<byteA>>();
+      auto depths = make_shared<rai::Array<floatA>>();
+      double time;
+      {
+        pybind11::gil_scoped_release release;
+        time = self->getImagesAndDepths(*imgs, *depths, sensors);
+      }
+      pybind11::list images, depthList;
+      for(uint i=0;i<imgs->N;i++){ //views sharing the batch
+        images.append(Array2numpy_shared<byte>(imgs->elem(i), imgs));
+        depthList.append(Array2numpy_shared<float>(depths->elem(i), depths));
+      }
+      return pybind11::make_tuple(images, depthList, time); },
+       "returns images and depths of several camera sensors -- in simulation all from one render batch, with their common ctrl time (-1 for real cameras)",
+       pybind11::arg("sensorNames"))
+
   .def("getImageDepthPcl",  [](std::shared_ptr<BotOp>& self, const char* sensorName, bool globalCoordinates) {
-         byteA img;
-         floatA depth;
-         arr pts;
-         self->getImageDepthPcl(img, depth, pts, sensorName, globalCoordinates);
-         return pybind11::make_tuple(Array2numpy<byte>(img),
-                                     Array2numpy<float>(depth),
-                                     Array2numpy<double>(pts)); },
+         auto img = make_shared<byteA>();
+         auto depth = make_shared<floatA>();
+         auto pts = make_shared<arr>();
+         {
+           pybind11::gil_scoped_release release;
+           self->getImageDepthPcl(*img, *depth, *pts, sensorName, globalCoordinates);
+         }
+         return pybind11::make_tuple(Array2numpy_shared<byte>(*img, img),
+                                     Array2numpy_shared<float>(*depth, depth),
+                                     Array2numpy_shared<double>(*pts, pts)); },
        "returns image, depth and point cloud (assuming sensor knows intrinsics) from a camera sensor, optionally in global instead of camera-frame-relative coordinates",
        pybind11::arg("sensorName"),
        pybind11::arg("globalCoordinates") = false)
 
-  .def("sync", &BotOp::sync,
+  .def("sync", &BotOp::sync, ReleaseGIL(),
        "sync your workspace configuration C with the robot state",
        pybind11::arg("C"),
        pybind11::arg("waitTime") = .1)
 
-  .def("wait", &BotOp::wait,
+  .def("wait", &BotOp::wait, ReleaseGIL(),
        "repeatedly sync your workspace C until a key is pressed or motion ends (optionally)",
        pybind11::arg("C"),
        pybind11::arg("forKeyPressed") = true,
        pybind11::arg("forTimeToEnd") = true,
        pybind11::arg("forGripper") = false)
 
-  .def("home", &BotOp::home,
+  .def("stepSim", &BotOp::stepSim, ReleaseGIL(),
+       "lockstep simulation (botsim/lockstep: true): advance the simulation by the given number of control steps, at CPU speed",
+       pybind11::arg("steps") = 1)
+
+  .def("runUntilEnd", &BotOp::runUntilEnd, ReleaseGIL(),
+       "lockstep simulation: step until the current motion ended (or maxTime passed); returns the simulated time advanced",
+       pybind11::arg("maxTime") = 60.)
+
+  .def("isLockstep", &BotOp::isLockstep,
+       "whether the simulation only advances on stepSim/runUntilEnd/sync")
+
+  .def("simSnapshot", [](std::shared_ptr<BotOp>& self){ return std::const_pointer_cast<BotSimSnapshot>(self->simSnapshot()); },
+       "capture the simulation's dynamic state (joints, dynamic frames, velocities, grippers, ctrl time)")
+
+  .def("simRestore", [](std::shared_ptr<BotOp>& self, const std::shared_ptr<BotSimSnapshot>& snap){ self->simRestore(snap); }, ReleaseGIL(),
+       "restore a simulation snapshot; the motion reference is not part of it -- set a new motion afterwards",
+       pybind11::arg("snapshot"))
+
+  .def("home", &BotOp::home, ReleaseGIL(),
        "immediately drive the robot home (see get_qHome); keeps argument C synced; same as moveTo(qHome, 1., True); wait(C);",
        pybind11::arg("C"))
 
-  .def("stop", &BotOp::stop,
+  .def("stop", &BotOp::stop, ReleaseGIL(),
        "immediately stop the robot; keeps argument C synced; same as moveTo(get_q(), 1., True); wait(C);",
        pybind11::arg("C"))
 
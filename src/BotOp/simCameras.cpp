@@ -0,0 +1,149 @@
+#include "simCameras.h"
+
+//===========================================================================
+
+SimCameraRenderer::SimCameraRenderer(const rai::Configuration& C, double rate, bool loop)
+  : Thread("SimCameraRenderer", 1./rate),
+    view(C, true){
+  renderC.copy(C);
+  if(loop) threadLoop();
+}
+
+SimCameraRenderer::~SimCameraRenderer(){
+  {
+    std::lock_guard<std::mutex> lock(snapshotMutex);
+    snapshotHas=true; //release a waiting render cycle
+  }
+  snapshotReady.notify_all();
+  threadClose();
+}
+
+std::shared_ptr<SimCameraRenderer::Sensor> SimCameraRenderer::findSensor(const char* name){
+  for(std::shared_ptr<Sensor>& s:sensors) if(s->name==name) return s;
+  return std::shared_ptr<Sensor>();
+}
+
+void SimCameraRenderer::addSensor(const char* name){
+  auto mux = stepMutex(RAI_HERE); //not concurrently with a render cycle (the view is not thread-safe)
+  std::lock_guard<std::mutex> lock(sensorsMutex);
+  if(findSensor(name)) return;
+  auto s = make_shared<Sensor>();
+  s->name = name;
+  view.addSensor(name);
+  s->fxycxy = view.currentSensor->getFxycxy();
+  sensors.append(s);
+}
+
+bool SimCameraRenderer::hasSensor(const char* name){
+  std::lock_guard<std::mutex> lock(sensorsMutex);
+  return !!findSensor(name);
+}
+
+arr SimCameraRenderer::getFxycxy(const char* name){
+  std::lock_guard<std::mutex> lock(sensorsMutex);
+  std::shared_ptr<Sensor> s = findSensor(name);
+  CHECK(s, "sensor '" <<name <<"' not registered");
+  return s->fxycxy;
+}
+
+bool SimCameraRenderer::getFrame(Frame& frame, const char* name, double timeout){
+  std::unique_lock<std::mutex> lock(sensorsMutex);
+  std::shared_ptr<Sensor> s = findSensor(name);
+  CHECK(s, "sensor '" <<name <<"' not registered");
+  if(s->buffer[s->front].time<0.){
+    newFrame.wait_for(lock, std::chrono::duration<double>(timeout), [&](){ return s->buffer[s->front].time>=0.; });
+    if(s->buffer[s->front].time<0.) return false;
+  }
+  frame = s->buffer[s->front];
+  return true;
+}
+
+bool SimCameraRenderer::getFrames(rai::Array<Frame>& frames, const StringA& names, double timeout){
+  std::unique_lock<std::mutex> lock(sensorsMutex);
+  rai::Array<std::shared_ptr<Sensor>> S;
+  for(const rai::String& name:names){
+    std::shared_ptr<Sensor> s = findSensor(name);
+    CHECK(s, "sensor '" <<name <<"' not registered");
+    S.append(s);
+  }
+  if(!S.N){ frames.clear(); return true; }
+  auto common = [&](){ //all rendered, in the same cycle
+    double t = S(0)->buffer[S(0)->front].time;
+    if(t<0.) return false;
+    for(std::shared_ptr<Sensor>& s:S) if(s->buffer[s->front].time!=t) return false;
+    return true;
+  };
+  bool ok = common();
+  if(!ok){
+    newFrame.wait_for(lock, std::chrono::duration<double>(timeout), common);
+    ok = common();
+  }
+  frames.resize(S.N);
+  for(uint i=0;i<S.N;i++) frames(i) = S(i)->buffer[S(i)->front];
+  return ok;
+}
+
+void SimCameraRenderer::offerFrameState(const rai::Configuration& simC, double ctrlTime){
+  if(!snapshotWanted) return; //(benign race: read without lock -- at worst one step late)
+  {
+    std::lock_guard<std::mutex> lock(snapshotMutex);
+    snapshotX = simC.getFrameState();
+    snapshotTime = ctrlTime;
+    snapshotWanted = false;
+    snapshotHas = true;
+  }
+  snapshotReady.notify_all();
+}
+
+void SimCameraRenderer::step(){
+  if(!sensors.N) return;
+
+  //-- get a pose snapshot from the physics thread (taken at the end of its next step)
+  arr X;
+  double ctrlTime;
+  {
+    std::unique_lock<std::mutex> lock(snapshotMutex);
+    snapshotHas = false;
+    snapshotWanted = true;
+    snapshotReady.wait_for(lock, std::chrono::seconds(1), [&](){ return snapshotHas; });
+    if(!snapshotHas || !snapshotX.N){ snapshotWanted=false; return; }
+    X = snapshotX;
+    ctrlTime = snapshotTime;
+  }
+
+  render(X, ctrlTime);
+}
+
+void SimCameraRenderer::renderSync(const rai::Configuration& simC, double ctrlTime){
+  auto mux = stepMutex(RAI_HERE);
+  render(simC.getFrameState(), ctrlTime);
+}
+
+void SimCameraRenderer::render(const arr& X, double ctrlTime){
+  //-- one pose update for all views
+  renderC.setFrameState(X);
+  view.updateConfiguration(renderC);
+
+  rai::Array<std::shared_ptr<Sensor>> S;
+  {
+    std::lock_guard<std::mutex> lock(sensorsMutex);
+    S = sensors;
+  }
+
+  //-- render all views into their back buffers (readers only touch the front ones)
+  for(std::shared_ptr<Sensor>& s:S){
+    Frame& back = s->buffer[1-s->front];
+    view.selectSensor(s->name);
+    view.computeImageAndDepth(back.image, back.depth);
+    back.pose = view.currentSensor->pose();
+    back.time = ctrlTime;
+  }
+
+  //-- publish all views at once (common timestamp)
+  {
+    std::lock_guard<std::mutex> lock(sensorsMutex);
+    for(std::shared_ptr<Sensor>& s:S) s->front = 1-s->front;
+  }
+  newFrame.notify_all();
+  renders++;
+}
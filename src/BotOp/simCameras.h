@@ -0,0 +1,89 @@
+#pragma once
+
+#include <Core/thread.h>
+#include <Kin/kin.h>
+#include <Kin/cameraview.h>
+
+#include <condition_variable>
+#include <mutex>
+
+//===========================================================================
+//
+// rendering of the simulated cameras, decoupled from the physics thread
+//
+// The renderer owns a copy of the sim configuration and its own CameraView. At botsim/cameraRate
+// it asks the physics thread for a snapshot of all frame poses (a plain copy at the end of the
+// next sim step), renders all registered sensors from it, and publishes the results into
+// double buffers. Readers get the latest completed frame under a short buffer lock -- neither
+// rendering nor reading ever takes the physics thread's stepMutex.
+//
+// All sensors are rendered as one batch: a single pose upload into the one CameraView (whose GL
+// context holds the geometry of all views), then one render per view, and a common flip of all
+// buffers -- so frames of the same cycle carry the same timestamp (see getFrames).
+//
+// In lockstep mode (no sim thread) there is no render loop: renderSync renders from the
+// current state in the calling thread.
+//
+
+struct SimCameraRenderer : Thread {
+  /// one completed render of one sensor
+  struct Frame {
+    byteA image;
+    floatA depth;
+    rai::Transformation pose;
+    double time=-1.; //ctrlTime of the pose snapshot; <0: nothing rendered yet
+    Frame(){ pose.setZero(); }
+  };
+
+  SimCameraRenderer(const rai::Configuration& C, double rate, bool loop=true);
+  ~SimCameraRenderer();
+
+  /// registers a sensor (rendered from the next cycle on); thread-safe
+  void addSensor(const char* name);
+  bool hasSensor(const char* name);
+
+  /// latest completed frame of a sensor; waits for the first one (up to timeout) if there is none yet
+  bool getFrame(Frame& frame, const char* name, double timeout=10.);
+  arr getFxycxy(const char* name);
+
+  /// latest completed frames of several sensors, all from the same render cycle (common time);
+  /// waits (up to timeout) until every sensor has been rendered in a common cycle; false on timeout
+  /// (frames then holds the latest frame of each sensor, which may differ in time or be empty)
+  bool getFrames(rai::Array<Frame>& frames, const StringA& names, double timeout=10.);
+
+  /// physics side: called at the end of each sim step; copies the frame state only if a render cycle waits for it
+  void offerFrameState(const rai::Configuration& simC, double ctrlTime);
+
+  /// lockstep: render all sensors now from the given state (calling thread)
+  void renderSync(const rai::Configuration& simC, double ctrlTime);
+
+  uint64_t renderCount() const { return renders; }
+
+private:
+  struct Sensor {
+    rai::String name;
+    arr fxycxy;
+    Frame buffer[2];
+    int front=0;
+  };
+
+  rai::Configuration renderC;
+  rai::CameraView view;
+
+  std::mutex sensorsMutex; //guards the sensor list and the front indices (held briefly)
+  rai::Array<std::shared_ptr<Sensor>> sensors;
+  std::condition_variable newFrame;
+
+  //-- pose snapshot exchange with the physics thread
+  std::mutex snapshotMutex;
+  std::condition_variable snapshotReady;
+  bool snapshotWanted=false, snapshotHas=false;
+  arr snapshotX;
+  double snapshotTime=0.;
+
+  std::atomic<uint64_t> renders={0};
+
+  void step();
+  void render(const arr& X, double ctrlTime);
+  std::shared_ptr<Sensor> findSensor(const char* name);
+};
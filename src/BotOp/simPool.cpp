@@ -0,0 +1,95 @@
+#include "simPool.h"
+#include "bot.h"
+#include "simulation.h"
+
+#include <atomic>
+#include <thread>
+
+//===========================================================================
+
+struct BotSimPool::Worker {
+  uint id;
+  rai::Configuration C; //this worker's own copy
+
+  Worker(uint _id, const rai::Configuration& C0) : id(_id) { C.copy(C0); }
+
+  void rollout(BotSimResult& res, const BotSimScript& script);
+};
+
+void BotSimPool::Worker::rollout(BotSimResult& res, const BotSimScript& script){
+  rai::Configuration Cs;
+  Cs.copy(C);
+  if(script.q0.N) Cs.setJointState(script.q0);
+
+  double wall0 = rai::realTime();
+  BotOp bot(Cs, false, 1, BotOp::displayHeadless); //lockstep sim: advances only below; no viewer, whatever rai.cfg says
+  double t0 = bot.get_t();
+
+  uint steps=0;
+  auto stepAndRecord = [&](){
+    bot.stepSim(1);
+    steps++;
+    double t = bot.get_t()-t0;
+    res.times.append(t);
+    res.q.append(bot.get_q());
+    if(script.contactPeriod && !(steps%script.contactPeriod)){
+      Cs.setJointState(bot.get_q());
+      bot.simthread->pullDynamicStates(Cs);
+      Cs.ensure_proxies();
+      for(const rai::Proxy& p:Cs.proxies) if(p.d<0.){
+        BotSimContact* c=0;
+        for(BotSimContact& x:res.contacts) if(x.a==p.a->name && x.b==p.b->name){ c=&x; break; }
+        if(!c){
+          res.contacts.push_back({p.a->name, p.b->name, t, t, 0.});
+          c = &res.contacts.back();
+        }
+        c->lastTime = t;
+        c->maxDepth = rai::MAX(c->maxDepth, -p.d);
+      }
+    }
+  };
+
+  for(const BotSimScript::Move& m:script.moves){
+    if(m.startTime>=0.) while(bot.get_t()-t0 < m.startTime-1e-9 && bot.get_t()-t0 < script.maxTime) stepAndRecord();
+    bot.move(m.path, m.times, m.overwrite, m.overwrite ? bot.get_t() : -1.);
+  }
+  while(bot.getTimeToEnd()>0. && bot.get_t()-t0 < script.maxTime) stepAndRecord();
+
+  uint dim = res.times.N ? res.q.N/res.times.N : 0;
+  if(dim) res.q.reshape(res.times.N, dim);
+  res.simTime = bot.get_t()-t0;
+  res.wallTime = rai::realTime()-wall0;
+  res.worker = id;
+}
+
+//===========================================================================
+
+BotSimPool::BotSimPool(const rai::Configuration& C, uint nWorkers){
+  if(!nWorkers) nWorkers = rai::MAX(1u, std::thread::hardware_concurrency());
+  for(uint i=0;i<nWorkers;i++) workers.push_back(std::make_unique<Worker>(i, C));
+}
+
+BotSimPool::~BotSimPool(){}
+
+std::vector<BotSimResult> BotSimPool::run(const std::vector<BotSimScript>& scripts){
+  std::vector<BotSimResult> results(scripts.size());
+  std::atomic<uint> next(0);
+
+  std::vector<std::thread> threads;
+  for(std::unique_ptr<Worker>& w:workers){
+    Worker* worker = w.get();
+    threads.emplace_back([&, worker](){
+      for(;;){
+        uint i = next++;
+        if(i>=scripts.size()) break;
+        try{
+          worker->rollout(results[i], scripts[i]);
+        }catch(const std::exception& ex){
+          LOG(-1) <<"rollout " <<i <<" on worker " <<worker->id <<" failed: " <<ex.what();
+        }
+      }
+    });
+  }
+  for(std::thread& t:threads) t.join();
+  return results;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Kin/kin.h>
+
+#include <memory>
+#include <vector>
+
+//===========================================================================
+//
+// a pool of headless, lockstep BotOp simulations for batch rollouts
+//
+// Each worker thread owns a copy of the configuration and runs one script at a time in a
+// fresh lockstep, headless BotOp (both forced per instance), i.e. at CPU speed and without any display. Scripts
+// are handed out dynamically; results come back in script order.
+//
+
+/// one rollout: moves issued to a BotOp, then stepped until the motion ended (or maxTime)
+struct BotSimScript {
+  struct Move {
+    arr path, times;       ///< as for BotOp::move
+    bool overwrite=false;  ///< overwrite (at the issuing time) instead of append
+    double startTime=-1.;  ///< issue at this time (relative to the rollout start); -1: right after the previous
+  };
+  std::vector<Move> moves;
+  arr q0;                  ///< initial joint state (default: the pool's configuration)
+  double maxTime=30.;      ///< upper bound on the simulated time
+  uint contactPeriod=10;   ///< check for contacts every n control steps (0: never)
+
+  BotSimScript& move(const arr& path, const arr& times, bool overwrite=false, double startTime=-1.){
+    moves.push_back({path, times, overwrite, startTime});
+    return *this;
+  }
+};
+
+struct BotSimContact {
+  rai::String a, b;         ///< frame names
+  double firstTime, lastTime;
+  double maxDepth;          ///< max penetration observed
+};
+
+struct BotSimResult {
+  arr times;                            ///< (relative) time of each control step
+  arr q;                                ///< joint state of each control step, T x dim
+  std::vector<BotSimContact> contacts;  ///< penetrating pairs
+  double simTime=0., wallTime=0.;       ///< simulated and wall time of the rollout [sec]
+  uint worker=0;
+};
+
+struct BotSimPool {
+  /// nWorkers=0: one per hardware thread
+  BotSimPool(const rai::Configuration& C, uint nWorkers=0);
+  ~BotSimPool();
+
+  /// runs all scripts on the workers; blocking; result i belongs to script i
+  std::vector<BotSimResult> run(const std::vector<BotSimScript>& scripts);
+
+  uint size() const { return workers.size(); }
+
+private:
+  struct Worker;
+  std::vector<std::unique_ptr<Worker>> workers;
+};
@@ -1,25 +1,55 @@
 #include "simulation.h"
+#include "simCameras.h"
 #include <Kin/kin.h>
 #include <Kin/frame.h>
 #include <Kin/F_collisions.h>
 #include <Kin/viewer.h>
+#include <RealTime/ctrlChannel.h>
+#include <RealTime/rtConfig.h>
+#include <RealTime/telemetry.h>
+#include <RealTime/timingStats.h>
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
 
 void naturalGains(double& Kp, double& Kd, double decayTime, double dampingRatio);
 
+//the live sims of this process (e.g. of a BotSimPool), so that each writes its own telemetry file
+static std::mutex simInstancesMutex;
+static std::vector<bool> simInstances;
+
+static uint claimSimInstance(){
+  std::lock_guard<std::mutex> lock(simInstancesMutex);
+  for(uint i=0;i<simInstances.size();i++) if(!simInstances[i]){ simInstances[i]=true; return i; }
+  simInstances.push_back(true);
+  return simInstances.size()-1;
+}
+
+static void releaseSimInstance(uint i){
+  std::lock_guard<std::mutex> lock(simInstancesMutex);
+  simInstances[i]=false;
+}
+
 BotThreadedSim::BotThreadedSim(const rai::Configuration& C,
                                const Var<rai::CtrlCmdMsg>& _cmd, const Var<rai::CtrlStateMsg>& _state,
                                const StringA& joints,
-                               double _tau, double hyperSpeed)
+                               double _tau, double hyperSpeed,
+                               const std::shared_ptr<CtrlChannel>& _channel,
+                               int _lockstep, int _verbose)
   : RobotAbstraction(_cmd, _state),
     Thread("FrankaThread_Emulated"),
     simConfig(C),
-    tau(_tau){
+    tau(_tau),
+    instance(claimSimInstance()),
+    channel(_channel){
 
   //create a rai Simulator!
-  int verbose = rai::getParameter<int>("botsim/verbose", 1);
+  int verbose = (_verbose<0 ? rai::getParameter<int>("botsim/verbose", 1) : _verbose);
   if(tau<0.) tau = rai::getParameter<double>("botsim/tau", .01);
   if(hyperSpeed<0.) hyperSpeed = rai::getParameter<double>("botsim/hyperSpeed", 1.);
   Thread::metronome.reset(tau/hyperSpeed);
+  lockstep = (_lockstep<0 ? rai::getParameter<bool>("botsim/lockstep", false) : _lockstep>0);
   rai::String engine = rai::getParameter<rai::String>("botsim/engine", "physx");
   sim=make_shared<rai::Simulation>(simConfig, rai::Enum<rai::Simulation::Engine>(engine), verbose);
 
@@ -45,53 +75,178 @@ BotThreadedSim::BotThreadedSim(const rai::Configuration& C,
       q_indices.setStraightPerm(q_real.N);
     }
   }
-  state.set()->q = q_real;
-  state.set()->qDot = qDot_real;
+
+  //-- state/command exchange with the user side
+  if(!channel){
+    channel = make_shared<CtrlChannel>(q_real.N);
+    CtrlChannel::attach(channel, cmd);
+    mirrorState = true;
+  }
+  channelSlot = channel->registerRobot(q_indices, "BotThreadedSim", tau, metronome.ticInterval);
+  q_pub.resize(q_indices.N);
+  qDot_pub.resize(q_indices.N);
+  tauExternal_pub.resize(q_indices.N).setZero(); //the sim does not estimate external torques
+  cmd_q_ref.resize(q_real.N);
+  cmd_qDot_ref.resize(q_real.N);
+  cmd_qDDot_ref.resize(q_real.N);
+  cmd_posVel.resize(2*q_real.N);
+  for(uint i=0;i<q_indices.N;i++){ q_pub.elem(i) = q_real(q_indices(i)); qDot_pub.elem(i) = qDot_real(q_indices(i)); }
+  channel->publishState(channelSlot, q_pub.p, qDot_pub.p);
+  if(mirrorState) channel->mirrorState(state);
+
   //emuConfig.watch(false, STRING("EMULATION - initialization"));
   //emuConfig.gl()->update(0, true);
-  threadLoop();
-  state.waitForNextRevision(); //this is enough to ensure the ctrl loop is running
+  if(lockstep){
+    stepSim(1); //first tick: publishes ctrlTime and initializes the reference
+  }else{
+    uint64_t rev = channel->getRevision();
+    threadLoop();
+    while(channel->getRevision()==rev) rai::wait(.001); //this is enough to ensure the ctrl loop is running
+  }
 }
 
 BotThreadedSim::~BotThreadedSim(){
   LOG(0) <<"shutting down SimThread";
+  {
+    auto mux = stepMutex(RAI_HERE);
+    cameras.reset();
+  }
   threadClose();
   sim.reset();
   simConfig.view_close();
+  telemetry.reset(); //closes the file before another sim may take its name
+  releaseSimInstance(instance);
+}
+
+/// is user frame f (still) the dynamic body / inactive 1D joint (gripper) of sim frame s?
+static bool isDynamicBody(const rai::Frame* f, const rai::Frame* s){
+  return f->inertia && f->inertia->type==rai::BT_dynamic && f->name==s->name;
+}
+static bool isInactiveJoint(const rai::Frame* f, const rai::Frame* s){
+  return f->joint && !f->joint->active && f->joint->dim==1 && s->joint && f->joint->qIndex==s->joint->qIndex && f->name==s->name;
+}
+
+bool BotThreadedSim::DynamicIndex::valid(const rai::Configuration& C, const rai::Configuration& S) const{
+  if(this->C!=&C || nFrames!=C.frames.N) return false;
+  for(uint id:bodies) if(id>=S.frames.N || !isDynamicBody(C.frames.elem(id), S.frames.elem(id))) return false;
+  for(uint id:joints) if(id>=S.frames.N || !isInactiveJoint(C.frames.elem(id), S.frames.elem(id))) return false;
+  return true;
 }
 
 void BotThreadedSim::pullDynamicStates(rai::Configuration& C){
   auto mux = stepMutex(RAI_HERE);
-  for(rai::Frame *f:C.frames){
-    if(f->inertia && f->inertia->type==rai::BT_dynamic){
-      f->set_X() = simConfig.frames(f->ID)->ensure_X();
+
+  //-- (re-)index if C is new or its frame set changed: the index holds frame IDs, each re-checked
+  //   against C before use (frames may have been deleted and added without changing the count)
+  if(!dynIndex.valid(C, simConfig)){
+    dynIndex.C = &C;
+    dynIndex.nFrames = C.frames.N;
+    dynIndex.bodies.clear();
+    dynIndex.joints.clear();
+    for(rai::Frame *f:C.frames){
+      if(f->inertia && f->inertia->type==rai::BT_dynamic){
+        dynIndex.bodies.append(f->ID);
+      }
+      if(f->joint && !f->joint->active && f->joint->dim==1){ //gripper?
+        CHECK_EQ(f->joint->qIndex, simConfig.frames(f->ID)->joint->qIndex, "");
+        dynIndex.joints.append(f->ID);
+      }
     }
-    if(f->joint && !f->joint->active && f->joint->dim==1){ //gripper?
-      CHECK_EQ(f->joint->qIndex, simConfig.frames(f->ID)->joint->qIndex, "");
-      f->joint->setDofs(simConfig.qInactive, f->joint->qIndex);
+  }
+
+  //-- copy
+  for(uint id:dynIndex.bodies) C.frames.elem(id)->set_X() = simConfig.frames.elem(id)->ensure_X();
+  for(uint id:dynIndex.joints){ rai::Joint* j = C.frames.elem(id)->joint; j->setDofs(simConfig.qInactive, j->qIndex); }
+}
+
+std::shared_ptr<const BotSimSnapshot> BotThreadedSim::snapshot(){
+  auto mux = stepMutex(RAI_HERE);
+  auto snap = make_shared<BotSimSnapshot>();
+  snap->ctrlTime = ctrlTime;
+  snap->q_real = q_real;
+  snap->qDot_real = qDot_real;
+  snap->qInactive = simConfig.qInactive;
+  snap->simState = sim->getState();
+  for(GripperSim* g:grippers){
+    BotSimSnapshot::Gripper s = {g->gripperName, g->cmdObjName, g->command, g->cmdWidth, g->cmdSpeed, g->q, g->isClosing, g->isOpening};
+    if(s.command==BotSimSnapshot::gripperNone){ s.width = sim->getGripperWidth(g->gripperName); s.speed = .2; }
+    snap->grippers.push_back(s);
+  }
+  return snap;
+}
+
+void BotThreadedSim::restore(const BotSimSnapshot& snap){
+  auto mux = stepMutex(RAI_HERE);
+  sim->restoreState(snap.simState);
+  simConfig.qInactive = snap.qInactive;
+  q_real = snap.q_real;
+  qDot_real = snap.qDot_real;
+  ctrlTime = snap.ctrlTime;
+  channel->setTime(ctrlTime); //also the time of the publish below: the history drops the samples after the snapshot
+
+  //re-issue each gripper's command as of the snapshot (a never-commanded gripper holds its width)
+  for(const BotSimSnapshot::Gripper& s:snap.grippers) for(GripperSim* g:grippers) if(g->gripperName==s.name){
+    g->command = s.command;  g->cmdWidth = s.width;  g->cmdSpeed = s.speed;  g->cmdObjName = s.objName;
+    g->q = s.q;  g->isClosing = s.isClosing;  g->isOpening = s.isOpening;
+    switch(s.command){
+      case BotSimSnapshot::gripperNone:
+      case BotSimSnapshot::gripperMove:  sim->moveGripper(s.name, s.width, s.speed);  break;
+      case BotSimSnapshot::gripperClose:  sim->closeGripper(s.name, s.width, s.speed);  break;
+      case BotSimSnapshot::gripperCloseGrasp:  sim->closeGripperGrasp(s.name, s.objName);  break;
     }
   }
+
+  //publish right away, so that the user side sees the restored state before the next step
+  for(uint i=0;i<q_indices.N;i++){ q_pub.elem(i) = q_real(q_indices(i)); qDot_pub.elem(i) = qDot_real(q_indices(i)); }
+  channel->publishState(channelSlot, q_pub.p, qDot_pub.p);
+}
+
+void BotThreadedSim::stepSim(uint n){
+  CHECK(lockstep, "stepSim requires botsim/lockstep: true (otherwise the sim thread is looping)");
+  auto mux = stepMutex(RAI_HERE);
+  for(uint i=0;i<n;i++){
+    step();
+    step_count++;
+  }
+}
+
+SimCameraRenderer& BotThreadedSim::cameraRenderer(){
+  //the physics lock is taken once, to create it (copies simConfig, and step() reads the pointer under
+  //stepMutex); after that, image requests and frame polls never contend with step()
+  std::call_once(camerasOnce, [this](){
+    double rate = rai::getParameter<double>("botsim/cameraRate", 20.);
+    auto mux = stepMutex(RAI_HERE);
+    cameras = make_shared<SimCameraRenderer>(simConfig, rate, !lockstep);
+  });
+  return *cameras;
+}
+
+void BotThreadedSim::renderCamerasSync(){
+  CHECK(lockstep, "only in lockstep mode -- otherwise the renderer runs on its own");
+  cameraRenderer().renderSync(simConfig, ctrlTime);
+}
+
+void BotThreadedSim::open(){
+  rai::applyRtConfig(rai::RtThreadConfig::fromParams("botsim"), "BotThreadedSim");
 }
 
 void BotThreadedSim::step(){
+  rai::LoopTiming& timing = channel->timing(channelSlot);
+  timing.tickBegin();
+
   //-- get real time
-  ctrlTime += tau;
+  ctrlTime = channel->tick(channelSlot, tau);
   //  ctrlTime = rai::realTime();
 
-  //-- publish state
+  //-- publish state (all buffers are persistent; nothing below allocates in steady state)
   {
-    arr tauExternal;
-    tauExternal = zeros(q_real.N);
-    auto stateSet = state.set();
-    stateSet->ctrlTime=ctrlTime;
-    stateSet->q.resize(q_real.N).setZero();
-    stateSet->qDot.resize(qDot_real.N).setZero();
-    stateSet->tauExternalIntegral.resize(q_real.N).setZero();
-    for(uint i:q_indices){
-      stateSet->q(i) = q_real(i);
-      stateSet->qDot(i) = qDot_real(i);
-      stateSet->tauExternalIntegral(i) = tauExternal(i);
+    rai::LatencyScope lockWait(timing.lockWait);
+    for(uint i=0;i<q_indices.N;i++){
+      q_pub.elem(i) = q_real(q_indices(i));
+      qDot_pub.elem(i) = qDot_real(q_indices(i));
     }
+    channel->publishState(channelSlot, q_pub.p, qDot_pub.p, tauExternal_pub.p);
+    if(mirrorState) channel->mirrorState(state);
   }
 
   //-- publish to sim_config
@@ -99,31 +254,33 @@ void BotThreadedSim::step(){
 //    sim_config.set()->setJointState(q);
 //  }
 
-  //-- get current ctrl
-  arr cmd_q_ref, cmd_qDot_ref, cmd_qDDot_ref, KpRef, KdRef, P_compliance; // TODO Kp, Kd, u_b and also read out the correct indices
+  //-- get current ctrl (the sim follows q_ref/qDot_ref only -- Kp, Kd, P_compliance are not emulated)
   {
-    auto cmdGet = cmd.get();
+    const rai::CtrlCmdMsg& cmdGet = channel->readCmd(channelSlot);
 
-    if(!cmdGet->ref){
+    if(!cmdGet.ref){
       cmd_q_ref = q_real;
       cmd_qDot_ref.resize(q_real.N).setZero();
       cmd_qDDot_ref.resize(q_real.N).setZero();
     }else{
       //get the reference from the callback (e.g., sampling a spline reference)
-      cmdGet->ref->getReference(cmd_q_ref, cmd_qDot_ref, cmd_qDDot_ref, q_real, qDot_real, ctrlTime);
+      rai::LatencyScope refTime(timing.reference);
+      cmdGet.ref->getReference(cmd_q_ref, cmd_qDot_ref, cmd_qDDot_ref, q_real, qDot_real, ctrlTime);
     }
-
-    KpRef = cmdGet->Kp;
-    KdRef = cmdGet->Kd;
-    P_compliance = cmdGet->P_compliance;
   }
 
   if(cmd_q_ref.N && cmd_qDot_ref.N){
-    sim->step((cmd_q_ref, cmd_qDot_ref), tau, sim->_posVel);
+    //concatenate into the preallocated buffer, instead of (cmd_q_ref, cmd_qDot_ref)
+    uint n = cmd_q_ref.N;
+    cmd_posVel.resize(n+cmd_qDot_ref.N);
+    memmove(cmd_posVel.p, cmd_q_ref.p, n*sizeof(double));
+    memmove(cmd_posVel.p+n, cmd_qDot_ref.p, cmd_qDot_ref.N*sizeof(double));
+    sim->step(cmd_posVel, tau, sim->_posVel);
   }else{
     sim->step({}, tau, sim->_none);
   }
-  q_real = simConfig.getJointState();
+  simConfig.ensure_q();
+  q_real = simConfig.q; //copies into q_real's storage (getJointState() would return a fresh array)
   if(cmd_qDot_ref.N==qDot_real.N) qDot_real = cmd_qDot_ref;
 
   //-- add other crazy perturbations?
@@ -151,25 +308,79 @@ void BotThreadedSim::step(){
 
   //-- data log?
   if(writeData>0 && !(step_count%1)){
-    if(!dataFile.is_open()) dataFile.open("z.panda.dat");
-    dataFile <<ctrlTime <<' '; //single number
-    q_real.modRaw().write(dataFile); //7
-    cmd_q_ref.modRaw().write(dataFile); //7
-    if(writeData>1){
-      qDot_real.modRaw().write(dataFile); //7
-      cmd_qDot_ref.modRaw().write(dataFile); //7
-      //qDDot_des.modRaw().write(dataFile); //7
-      //cmd_qDDot_ref.modRaw().write(dataFile);
-    }
-    if(writeData>2){
-    }
-    dataFile <<endl;
+    uint n=q_real.N;
+    if(!telemetry) telemetry = make_shared<rai::TelemetryRecorder>(instance ? STRING("z.panda." <<instance <<".tlm") : rai::String("z.panda.tlm"),
+                                                                   StringA{"time", "q", "q_ref", "qDot", "qDot_ref"},
+                                                                   uintA{1, n, n, n, n});
+    rai::TelemetryRecorder::Record rec = telemetry->begin();
+    rec(ctrlTime)(q_real, n)(cmd_q_ref, n)(qDot_real, n)(cmd_qDot_ref, n);
+    telemetry->commit(rec);
   }
+
+  //-- pose snapshot for the camera renderer (only when it waits for one)
+  if(cameras) cameras->offerFrameState(simConfig, ctrlTime);
+
+  timing.tickEnd();
+}
+
+CameraSim::CameraSim(const std::shared_ptr<BotThreadedSim>& _sim, const char* sensorName) : simthread(_sim) {
+  name = sensorName;
+  timeout = rai::getParameter<double>("botsim/cameraTimeout", 10.);
+  simthread->cameraRenderer().addSensor(name);
+}
+
+void CameraSim::getImageAndDepth(byteA& image, floatA& depth){
+  if(simthread->isLockstep()) simthread->renderCamerasSync();
+  SimCameraRenderer::Frame frame;
+  if(!simthread->cameraRenderer().getFrame(frame, name, timeout)){
+    LOG(-1) <<"no image from simulated camera '" <<name <<"' within " <<timeout <<"s -- returning an empty one";
+  }
+  image = frame.image;
+  depth = frame.depth;
+}
+
+double CameraSim::getImagesAndDepths(rai::Array<byteA>& images, rai::Array<floatA>& depths,
+                                     const std::shared_ptr<BotThreadedSim>& sim, const StringA& sensors, double timeout){
+  if(sim->isLockstep()) sim->renderCamerasSync(); //one batch for all
+  if(timeout<0.) timeout = rai::getParameter<double>("botsim/cameraTimeout", 10.);
+  rai::Array<SimCameraRenderer::Frame> frames;
+  bool common = sim->cameraRenderer().getFrames(frames, sensors, timeout);
+  if(!common) LOG(-1) <<"no common frame from simulated cameras " <<sensors <<" within " <<timeout <<"s -- returning the latest of each";
+  images.resize(frames.N);
+  depths.resize(frames.N);
+  for(uint i=0;i<frames.N;i++){
+    images(i) = frames(i).image;
+    depths(i) = frames(i).depth;
+  }
+  return (common && frames.N) ? frames(0).time : -1.;
+}
+
+arr CameraSim::getFxycxy(){
+  return simthread->cameraRenderer().getFxycxy(name);
+}
+
+rai::Transformation CameraSim::getPose(){
+  SimCameraRenderer::Frame frame;
+  simthread->cameraRenderer().getFrame(frame, name); //zero pose if there is no render
+  return frame.pose;
+}
+
+GripperSim::GripperSim(const std::shared_ptr<BotThreadedSim>& _simthread, const char* _gripperName)
+  : Thread("GripperSimulation"), simthread(_simthread), gripperName(_gripperName), q(.02) {
+  auto mux = simthread->stepMutex(RAI_HERE);
+  simthread->grippers.push_back(this);
+}
+
+GripperSim::~GripperSim(){
+  auto mux = simthread->stepMutex(RAI_HERE);
+  std::vector<GripperSim*>& G = simthread->grippers;
+  G.erase(std::remove(G.begin(), G.end(), this), G.end());
 }
 
 void GripperSim::open(double width, double speed) {
   auto mux = simthread->stepMutex(RAI_HERE);
   simthread->sim->moveGripper(gripperName, width, speed);
+  command=BotSimSnapshot::gripperMove;  cmdWidth=width;  cmdSpeed=speed;
   q=width;
   isClosing=false; isOpening=true;
 }
@@ -177,6 +388,7 @@ void GripperSim::open(double width, double speed) {
 void GripperSim::close(double force, double width, double speed) {
   auto mux = simthread->stepMutex(RAI_HERE);
   simthread->sim->closeGripper(gripperName, width, speed);
+  command=BotSimSnapshot::gripperClose;  cmdWidth=width;  cmdSpeed=speed;
   q=width;
   isOpening=false; isClosing=true;
 }
@@ -185,6 +397,7 @@ void GripperSim::closeGrasp(const char* objName, double force, double width, dou
   auto mux = simthread->stepMutex(RAI_HERE);
   simthread->sim->closeGripperGrasp(gripperName, objName);
   //sim->simConfig.attach(gripperName, objName);
+  command=BotSimSnapshot::gripperCloseGrasp;  cmdWidth=width;  cmdSpeed=speed;  cmdObjName=objName;
   q=width;
   isOpening=false; isClosing=true;
 }
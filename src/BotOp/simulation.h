@@ -4,30 +4,100 @@
 #include <Control/CtrlMsgs.h>
 #include <Kin/simulation.h>
 
+#include <mutex>
+
+struct CtrlChannel;
+struct SimCameraRenderer;
+struct GripperSim;
+namespace rai{ struct TelemetryRecorder; }
+
+/// compact state of a BotThreadedSim, immutable once taken -- copies share it
+struct BotSimSnapshot {
+  double ctrlTime;
+  arr q_real, qDot_real;                        //joint state (as the controller sees it)
+  arr qInactive;                                //inactive joints (gripper fingers)
+  std::shared_ptr<rai::SimulationState> simState; //engine state: frame poses and velocities
+
+  //the engine's gripper targets are not part of simState: each GripperSim's last command (re-issued on restore) and flags
+  enum GripperCommand { gripperNone=0, gripperMove, gripperClose, gripperCloseGrasp };
+  struct Gripper {
+    rai::String name, objName;
+    GripperCommand command;
+    double width, speed; //gripperNone: the width at the snapshot
+    double q;
+    bool isClosing, isOpening;
+  };
+  std::vector<Gripper> grippers;
+};
+
 struct BotThreadedSim : rai::RobotAbstraction, Thread {
   BotThreadedSim(const rai::Configuration& _sim_config,
                 const Var<rai::CtrlCmdMsg>& _cmd={}, const Var<rai::CtrlStateMsg>& _state={},
                 const StringA& joints={},
                 double _tau=-1,
-                double hyperSpeed=-1.);
+                double hyperSpeed=-1.,
+                const std::shared_ptr<CtrlChannel>& _channel={},
+                int _lockstep=-1, //-1: from botsim/lockstep
+                int _verbose=-1); //-1: from botsim/verbose (0: no display of the sim itself)
 
   ~BotThreadedSim();
 
+  /// copy the poses of dynamic bodies and the inactive 1D joints (grippers) from the sim into C;
+  /// the frames involved are indexed once per C (by ID; re-indexed when an indexed frame no longer matches)
   void pullDynamicStates(rai::Configuration& C);
+  /// force re-indexing, e.g., after making another frame dynamic without changing the frame count
+  void invalidateDynamicIndex(){ auto mux = stepMutex(RAI_HERE); dynIndex.C=0; }
+
+  /// lockstep mode (botsim/lockstep: true): the sim has no loop of its own -- simulated time advances
+  /// only here, by n steps of tau, in the calling thread and without sleeping (deterministic)
+  void stepSim(uint n=1);
+  bool isLockstep() const { return lockstep; }
+  double getTau() const { return tau; }
+
+  /// capture/restore the dynamic state (joints, dynamic frames, velocities, grippers, ctrlTime) --
+  /// for branching 'what if' rollouts from the same state; the motion reference is not part of it
+  std::shared_ptr<const BotSimSnapshot> snapshot();
+  void restore(const BotSimSnapshot& snap);
+
+  /// renderer of the simulated cameras (created on first use; renders off the physics thread; no locking after creation)
+  SimCameraRenderer& cameraRenderer();
+  /// lockstep: render all cameras now from the current sim state
+  void renderCamerasSync();
 
 private:
   rai::Configuration simConfig;
   double tau;
+  bool lockstep=false;
   double ctrlTime = 0.;
   arr q_real, qDot_real;
   uintA q_indices;
-  ofstream dataFile;
+  uint instance; //number among the live sims of this process (0: the first)
+  std::shared_ptr<rai::TelemetryRecorder> telemetry; //writeData>0: binary log z.panda.tlm (z.panda.<instance>.tlm), written off-thread
   FrameL collisionPairs;
+  std::shared_ptr<CtrlChannel> channel; //own channel (mirrored into state) if none is given
+  uint channelSlot=0;
+  bool mirrorState=false;
+  arr q_pub, qDot_pub, tauExternal_pub; //slice of this thread's joints, published to the channel
+  arr cmd_q_ref, cmd_qDot_ref, cmd_qDDot_ref, cmd_posVel; //per-step references -- persistent, so that step() does not allocate
+  std::shared_ptr<SimCameraRenderer> cameras; //set once under stepMutex; fed a pose snapshot at the end of step()
+  std::once_flag camerasOnce;
+  std::vector<GripperSim*> grippers; //registered under stepMutex, for snapshots
+
+  //-- index of the frames pullDynamicStates copies, for one user configuration
+  struct DynamicIndex {
+    const rai::Configuration* C=0;     //indexed configuration (0: invalid)
+    uint nFrames=0;                    //its frame count when indexed
+    uintA bodies;                      //frame IDs of dynamic bodies (same ID in the user and sim config)
+    uintA joints;                      //frame IDs of inactive 1D joints
+    /// the index still matches C: same count, and each indexed ID still names a frame of the same kind
+    bool valid(const rai::Configuration& C, const rai::Configuration& S) const;
+  } dynIndex;
 
   //two options: trivial double integrator model, or physical simulation
 protected:
   std::shared_ptr<rai::Simulation> sim;
 
+  void open();
   void step();
 
   friend struct GripperSim;
@@ -39,9 +109,13 @@ struct GripperSim : rai::GripperAbstraction, Thread{
   rai::String gripperName;
   double q;
   bool isClosing=false, isOpening=false;
+  //last command (for sim snapshots)
+  BotSimSnapshot::GripperCommand command=BotSimSnapshot::gripperNone;
+  double cmdWidth=0., cmdSpeed=0.;
+  rai::String cmdObjName;
 
-  GripperSim(const std::shared_ptr<BotThreadedSim>& _simthread, const char* _gripperName)
-    : Thread("GripperSimulation"), simthread(_simthread), gripperName(_gripperName), q(.02) {}
+  GripperSim(const std::shared_ptr<BotThreadedSim>& _simthread, const char* _gripperName);
+  ~GripperSim();
 
   //gripper virtual methods
   void calibrate() {}
@@ -61,26 +135,18 @@ struct GripperSim : rai::GripperAbstraction, Thread{
 
 struct CameraSim : rai::CameraAbstraction {
   std::shared_ptr<BotThreadedSim> simthread;
+  double timeout; ///< max wait [s] for the first render (botsim/cameraTimeout)
+
+  CameraSim(const std::shared_ptr<BotThreadedSim>& _sim, const char* sensorName);
+
+  /// latest completed render (does not block the physics thread); empty if there is none within timeout
+  virtual void getImageAndDepth(byteA& image, floatA& depth);
+  virtual arr getFxycxy();
+  virtual rai::Transformation getPose(); //pose at the latest completed render
 
-  CameraSim(const std::shared_ptr<BotThreadedSim>& _sim, const char* sensorName) : simthread(_sim) {
-    auto mux = simthread->stepMutex(RAI_HERE);
-    name = sensorName;
-    simthread->sim->addSensor(name);
-  }
-
-  virtual void getImageAndDepth(byteA& image, floatA& depth){
-    auto mux = simthread->stepMutex(RAI_HERE);
-    simthread->sim->selectSensor(name);
-    simthread->sim->getImageAndDepth(image, depth);
-  }
-  virtual arr getFxycxy(){
-    auto mux = simthread->stepMutex(RAI_HERE);
-    simthread->sim->selectSensor(name);
-    return simthread->sim->cameraview().currentSensor->getFxycxy();
-  }
-  virtual rai::Transformation getPose(){
-    auto mux = simthread->stepMutex(RAI_HERE);
-    simthread->sim->selectSensor(name);
-    return simthread->sim->cameraview().currentSensor->pose();
-  }
+  /// images and depths of several simulated cameras from the same render cycle; returns their common ctrlTime.
+  /// If there is no common cycle within timeout (<0: botsim/cameraTimeout), the latest image of each (possibly
+  /// empty) and -1
+  static double getImagesAndDepths(rai::Array<byteA>& images, rai::Array<floatA>& depths,
+                                   const std::shared_ptr<BotThreadedSim>& sim, const StringA& sensors, double timeout=-1.);
 };
@@ -0,0 +1,127 @@
+#include "fakeFranka.h"
+
+#include <Core/util.h>
+
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+namespace fakeFranka {
+
+//-- model constants (roughly Panda-like magnitudes)
+static const double inertia[7]  = {.8, .8, .6, .6, .15, .15, .05}; //diagonal link inertias
+static const double coupling    = .3;                               //M = diag(inertia) + coupling v v^T, v_i = cos(q_i) w_i
+static const double couplingW[7] = {.6, .6, .5, .5, .2, .2, .1};
+static const double gravityG[7] = {0., -20., 0., 15., 0., 2., 0.};  //G_i = g_i sin(q_i)
+static const double damping[7]  = {.5, .5, .5, .5, .2, .2, .1};     //viscous joint friction
+static const double tauMax[7]   = {87., 87., 87., 87., 12., 12., 12.};
+
+static void couplingVec(Vec7& v, const Vec7& q){
+  for(uint i=0;i<7;i++) v[i] = ::cos(q[i])*couplingW[i];
+}
+
+Mat7 Model::mass(const RobotState& s) const{
+  Vec7 v;
+  couplingVec(v, s.q);
+  Mat7 M;
+  for(uint i=0;i<7;i++) for(uint j=0;j<7;j++) M[7*i+j] = coupling*v[i]*v[j] + (i==j ? inertia[i] : 0.);
+  return M;
+}
+
+Vec7 Model::coriolis(const RobotState& s) const{
+  //simplified velocity-product term: d/dt(M) qDot with M's coupling part
+  Vec7 v, C;
+  couplingVec(v, s.q);
+  double vDot=0., vqDot=0.;
+  for(uint i=0;i<7;i++){
+    vDot += -::sin(s.q[i])*couplingW[i]*s.dq[i]*s.dq[i];
+    vqDot += v[i]*s.dq[i];
+  }
+  for(uint i=0;i<7;i++) C[i] = coupling*(v[i]*vDot - ::sin(s.q[i])*couplingW[i]*s.dq[i]*vqDot);
+  return C;
+}
+
+Vec7 Model::gravity(const RobotState& s) const{
+  Vec7 G;
+  for(uint i=0;i<7;i++) G[i] = gravityG[i]*::sin(s.q[i]);
+  return G;
+}
+
+//===========================================================================
+
+Robot::Robot(const char* ipAddress){
+  realTime = rai::getParameter<bool>("FakeFranka/realTime", true);
+  jitter = rai::getParameter<double>("FakeFranka/jitter", 20e-6);
+  packetLoss = rai::getParameter<double>("FakeFranka/packetLoss", 0.);
+  rnd.seed(rai::getParameter<uint>("FakeFranka/seed", 0));
+  arr q0 = rai::getParameter<arr>("FakeFranka/q0", arr{0., -.5, 0., -2., 0., 2., -.5});
+  CHECK_EQ(q0.N, 7, "");
+  for(uint i=0;i<7;i++){
+    state.q[i] = q0.elem(i);
+    state.dq[i] = state.tau_J[i] = state.tau_ext_hat_filtered[i] = 0.;
+  }
+  LOG(0) <<"fake franka at '" <<ipAddress <<"' (realTime: " <<realTime <<" jitter: " <<jitter <<" packetLoss: " <<packetLoss <<")";
+}
+
+void Robot::integrate(const Vec7& tau, double dt){
+  //M a = tau - C - damping*dq, with M = D + c v v^T solved by Sherman-Morrison
+  Vec7 v, b, Dinv_b, Dinv_v;
+  couplingVec(v, state.q);
+  Vec7 C = model.coriolis(state);
+  double vDb=0., vDv=0.;
+  for(uint i=0;i<7;i++){
+    b[i] = tau[i] - C[i] - damping[i]*state.dq[i];
+    Dinv_b[i] = b[i]/inertia[i];
+    Dinv_v[i] = v[i]/inertia[i];
+    vDb += v[i]*Dinv_b[i];
+    vDv += v[i]*Dinv_v[i];
+  }
+  double f = coupling*vDb/(1.+coupling*vDv);
+  Vec7 G = model.gravity(state);
+  for(uint i=0;i<7;i++){
+    double a = Dinv_b[i] - f*Dinv_v[i];
+    state.dq[i] += dt*a; //semi-implicit Euler
+    state.q[i] += dt*state.dq[i];
+    state.tau_J[i] = tau[i] + G[i];
+  }
+}
+
+void Robot::control(std::function<Torques(const RobotState&, Duration)> callback, bool limitRate, double cutoffFrequency){
+  typedef std::chrono::steady_clock clock;
+  std::normal_distribution<double> noise(0., jitter);
+  std::uniform_real_distribution<double> uniform(0., 1.);
+
+  Vec7 tau;
+  tau.fill(0.);
+  uint64_t pending=0; //ticks since the last callback
+  bool first=true;
+  clock::time_point next = clock::now();
+  for(;;){
+    //-- wait for the next 1kHz tick (with wake-up noise)
+    next += std::chrono::microseconds(1000);
+    if(realTime){
+      double delay = (jitter>0. ? ::fabs(noise(rnd)) : 0.);
+      std::this_thread::sleep_until(next + std::chrono::nanoseconds(int64_t(1e9*delay)));
+    }
+
+    //-- the robot holds the last torque through the tick
+    integrate(tau, .001);
+    pending++;
+
+    //-- lost packet: no callback this tick
+    if(!first && packetLoss>0. && uniform(rnd)<packetLoss) continue;
+
+    Torques cmd = callback(state, Duration(first ? 0 : pending));
+    first=false;
+    pending=0;
+
+    for(uint i=0;i<7;i++){
+      if(!std::isfinite(cmd.tau_J[i])) throw Exception("fake franka: non-finite torque command");
+      if(::fabs(cmd.tau_J[i])>tauMax[i]) throw Exception("fake franka: joint torque limit violated (reflex)");
+    }
+    tau = cmd.tau_J;
+    if(cmd.motion_finished) break;
+  }
+}
+
+} //namespace
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <stdexcept>
+
+//===========================================================================
+//
+// hardware-free stand-in for libfranka's torque control interface
+//
+// Mirrors the subset of franka::Robot/Model/RobotState/Torques/Duration that FrankaThread uses,
+// so that the complete control callback (state exchange, reference, stall logic, control law,
+// logging) runs at 1kHz without an arm -- for benchmarks and local regression runs. Select it
+// with 'Franka/fake: true' in rai.cfg. Parameters (rai.cfg):
+//
+//   FakeFranka/realTime: true      pace the loop at 1kHz (false: run as fast as possible)
+//   FakeFranka/jitter: 20e-6       std dev [s] of the wake-up delay of each tick
+//   FakeFranka/packetLoss: 0.      probability that a tick's callback is skipped (the next
+//                                  callback then sees a Duration of 2ms, as with libfranka)
+//   FakeFranka/seed: 0
+//   FakeFranka/q0: [...]           initial joint state
+//
+// The plant is a simple rigid-body model: M(q) qDDot = tau - C(q,qDot) - friction*qDot, with
+// torques commanded gravity-compensated (as with libfranka); tau_J = tau + G(q). Torques
+// beyond the Panda limits raise an Exception (like libfranka's reflexes).
+//
+
+namespace fakeFranka {
+
+typedef std::array<double, 7> Vec7;
+typedef std::array<double, 49> Mat7;
+
+struct Exception : std::runtime_error {
+  Exception(const char* msg) : std::runtime_error(msg) {}
+};
+
+struct RobotState {
+  Vec7 q, dq, tau_J, tau_ext_hat_filtered;
+};
+
+struct Duration {
+  uint64_t ms=0;
+  Duration(uint64_t _ms=0) : ms(_ms) {}
+  double toSec() const { return 1e-3*double(ms); }
+};
+
+struct Torques {
+  Vec7 tau_J;
+  bool motion_finished=false;
+  Torques(const Vec7& tau) : tau_J(tau) {}
+};
+
+inline Torques MotionFinished(Torques t){ t.motion_finished=true; return t; }
+
+struct Model {
+  Mat7 mass(const RobotState& s) const;
+  Vec7 coriolis(const RobotState& s) const;
+  Vec7 gravity(const RobotState& s) const;
+};
+
+struct Robot {
+  Robot(const char* ipAddress);
+
+  RobotState readOnce(){ return state; }
+  Model loadModel(){ return Model(); }
+  void setCollisionBehavior(const Vec7&, const Vec7&, const std::array<double, 6>&, const std::array<double, 6>&){}
+
+  /// runs the 1kHz loop until the callback returns MotionFinished; throws Exception on a reflex
+  void control(std::function<Torques(const RobotState&, Duration)> callback, bool limitRate=true, double cutoffFrequency=1000.);
+
+private:
+  RobotState state;
+  Model model;
+  bool realTime;
+  double jitter, packetLoss;
+  std::mt19937 rnd;
+
+  void integrate(const Vec7& tau, double dt);
+};
+
+} //namespace
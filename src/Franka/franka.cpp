@@ -1,14 +1,54 @@
 #include "franka.h"
 
-#ifdef RAI_FRANKA
+#include <RealTime/allocGuard.h>
+#include <RealTime/ctrlChannel.h>
+#include <RealTime/rtConfig.h>
+#include <RealTime/telemetry.h>
+#include <RealTime/timingStats.h>
+
+#include "fakeFranka.h"
 
+#ifdef RAI_FRANKA
 #include <franka/model.h>
 #include <franka/robot.h>
 #include <franka/exception.h>
+#endif
+
+//===========================================================================
+
+//-- the robot interfaces the control loop can run against (same callback contract)
+
+#ifdef RAI_FRANKA
+struct LibfrankaBackend{
+  typedef franka::Robot Robot;
+  typedef franka::Model Model;
+  typedef franka::RobotState RobotState;
+  typedef franka::Torques Torques;
+  typedef franka::Duration Duration;
+  typedef franka::Exception Exception;
+  static Torques motionFinished(const Torques& t){ return franka::MotionFinished(t); }
+};
+#endif
+
+struct FakeBackend{
+  typedef fakeFranka::Robot Robot;
+  typedef fakeFranka::Model Model;
+  typedef fakeFranka::RobotState RobotState;
+  typedef fakeFranka::Torques Torques;
+  typedef fakeFranka::Duration Duration;
+  typedef fakeFranka::Exception Exception;
+  static Torques motionFinished(const Torques& t){ return fakeFranka::MotionFinished(t); }
+};
+
+//===========================================================================
 
 void naturalGains(double& Kp, double& Kd, double decayTime, double dampingRatio);
 
-const char *frankaIpAddresses[2] = {"172.16.0.2", "172.17.0.2"};
+rai::String frankaIpAddress(uint robotID){
+  StringA ips = rai::getParameter<StringA>("Franka/ipAddresses", {"172.16.0.2", "172.17.0.2"});
+  CHECK_LE(robotID+1, ips.N, "no ip address for Franka " <<robotID <<" -- add it to Franka/ipAddresses");
+  return ips(robotID);
+}
 
 FrankaThread::~FrankaThread(){
   LOG(0) <<"shutting down Franka " <<robotID;
@@ -17,8 +57,6 @@ FrankaThread::~FrankaThread(){
   threadClose();
 }
 
-long c = 0;
-
 void FrankaThread::init(uint _robotID, const uintA& _qIndices) {
   robotID=_robotID;
   qIndices=_qIndices;
@@ -33,17 +71,38 @@ void FrankaThread::init(uint _robotID, const uintA& _qIndices) {
   //friction = rai::getParameter<arr>("Franka/friction", arr{0.8, 1.0, 0.8, 1.0, 0.9, 0.5, 0.4});
   LOG(0) << "FRANKA: Kp_freq:" << Kp_freq << " Kd_ratio:" << Kd_ratio <<" friction:" <<friction;
 
+  //-- diagonal PD gains, computed once for the callback
+  CHECK_EQ(Kp_freq.N, 7,"");
+  CHECK_EQ(Kd_ratio.N, 7,"");
+  for(uint i=0;i<7;i++){
+    double freq = Kp_freq.elem(i);
+    ws.Kp[i] = freq*freq;
+    ws.Kd[i] = 2.*Kd_ratio.elem(i)*freq;
+  }
+
   /* hand tuning result of friction calib:
      Franka/friction: [0.8, 1.0, 0.8, 1.0, 0.9, 0.5, 0.4]
      Franka/Kd_ratio: [0.6, 0.6, 0.3, 0.3, 0.3, 0.3, 0.4]
   */
 
+  //-- state/command exchange with the user side
+  if(!channel){
+    channel = make_shared<CtrlChannel>(qIndices_max+1);
+    CtrlChannel::attach(channel, cmd);
+    mirrorState = true;
+  }
+  channelSlot = channel->registerRobot(qIndices, STRING("FrankaThread" <<robotID), .001, .001,
+                                      CtrlChannel::stallPolicy(rai::getParameter<rai::String>("Franka/stallPolicy", "holdAll")));
+
   //-- choose robot/ipAddress
-  CHECK_LE(robotID, 1, "");
-  ipAddress = frankaIpAddresses[robotID];
+  ipAddress = frankaIpAddress(robotID);
+  useFake = rai::getParameter<bool>("Franka/fake", false);
+#ifndef RAI_FRANKA
+  if(!useFake) HALT("compiled without libfranka -- use 'Franka/fake: true' for the hardware-free backend");
+#endif
 
   //-- start thread and wait for first state signal
-  LOG(0) <<"launching Franka " <<robotID <<" at " <<ipAddress;
+  LOG(0) <<"launching " <<(useFake?"fake ":"") <<"Franka " <<robotID <<" at " <<ipAddress;
   threadStep();  //this is not looping! The step method passes a callback to robot.control, which is blocking! (that's why we use a thread) until stop becomes true
 
   for(uint i=0;i<200;i++){
@@ -57,14 +116,24 @@ void FrankaThread::init(uint _robotID, const uintA& _qIndices) {
 }
 
 void FrankaThread::step(){
+  if(useFake){ controlLoop<FakeBackend>(); return; }
+#ifdef RAI_FRANKA
+  controlLoop<LibfrankaBackend>();
+#endif
+}
+
+template<class B> void FrankaThread::controlLoop(){
+  // scheduling, pinning, memory locking of this (the control) thread
+  rai::applyRtConfig(rai::RtThreadConfig::fromParams("Franka", robotID), STRING("FrankaThread" <<robotID));
+
   // connect to robot
-  franka::Robot robot(ipAddress);
+  typename B::Robot robot(ipAddress.p);
 
   // load the kinematics and dynamics model
-  franka::Model model = robot.loadModel();
+  typename B::Model model = robot.loadModel();
 
-  arr lastTorque = zeros(7);
-  arr qDotFilter = zeros(7);
+  ws.lastTorque.fill(0.);
+  ws.qDotFilter.fill(0.);
   double qDotFilterAlpha = .7;
 
   // set collision behavior
@@ -73,293 +142,151 @@ void FrankaThread::step(){
                              {{100.0, 100.0, 100.0, 100.0, 100.0, 100.0}},
                              {{100.0, 100.0, 100.0, 100.0, 100.0, 100.0}});
 
-  //-- initialize state and ctrl with first state
+  //-- initialize state with first state
   {
-    franka::RobotState initial_state = robot.readOnce();
-    arr q_real, qDot_real;
-    q_real.setCarray(initial_state.q.begin(), initial_state.q.size());
-    qDot_real.setCarray(initial_state.dq.begin(), initial_state.dq.size());
-
-    auto stateSet = state.set();
-    auto cmdSet = cmd.set();
-
-    //ensure state variables have sufficient size
-    while(stateSet->q.N<=qIndices_max) stateSet->q.append(0.);
-    while(stateSet->qDot.N<=qIndices_max) stateSet->qDot.append(0.);
-    while(stateSet->tauExternalIntegral.N<=qIndices_max) stateSet->tauExternalIntegral.append(0.);
-
-    for(uint i=0; i<7; i++){
-      stateSet->q.elem(qIndices(i)) = q_real(i);
-      stateSet->qDot.elem(qIndices(i)) = qDot_real(i);
-      stateSet->tauExternalIntegral.elem(qIndices(i)) = 0.;
-      stateSet->tauExternalCount=0;
-    }
+    typename B::RobotState initial_state = robot.readOnce();
+    channel->publishState(channelSlot, initial_state.q.data(), initial_state.dq.data());
+    if(mirrorState) channel->mirrorState(state);
+
+    //size the full-size buffers once -- the callback only copies into them
+    double t;
+    channel->getState(ws.state_q, ws.state_qDot, t);
+    ws.cmd_q_ref.resize(channel->nJoints()).setZero();
+    ws.cmd_qDot_ref.resize(channel->nJoints()).setZero();
+    ws.cmd_qDDot_ref.resize(channel->nJoints()).setZero();
+
+    //the recorder for writeData (set at any time) -- its file is only created with the first record
+    if(!telemetry) telemetry = make_shared<rai::TelemetryRecorder>(STRING("z.panda"<<robotID <<".tlm"),
+                                                                   StringA{"time", "q", "q_ref", "qDot", "qDot_ref", "u", "tau_J", "G", "C", "qDDot_ref", "M"},
+                                                                   uintA{1, 7, 7, 7, 7, 7, 7, 7, 7, 7, 49},
+                                                                   1<<11); //20s at 100 records/s
   }
 
 
   //-- define the callback for the torque control loop
-  std::function<franka::Torques(const franka::RobotState&, franka::Duration)>
-      torque_control_callback = [&](const franka::RobotState& robot_state,
-                                    franka::Duration /*duration*/) -> franka::Torques {
+  std::function<typename B::Torques(const typename B::RobotState&, typename B::Duration)>
+      torque_control_callback = [&](const typename B::RobotState& robot_state,
+                                    typename B::Duration duration) -> typename B::Torques {
+    rai::RtAllocScope rtScope; //(debug builds) counts any heap allocation within this callback
+    rai::LoopTiming& timing = channel->timing(channelSlot);
+    timing.tickBegin();
 
     steps++;
 
-//    if(stop) return franka::MotionFinished(franka::Torques( std::array<double, 7>{0., 0., 0., 0., 0., 0., 0.}));
-
     //-- get current state from libfranka
-    arr q_real(robot_state.q.begin(), robot_state.q.size(), false);
-    arr qDot_real(robot_state.dq.begin(), robot_state.dq.size(), false);
-    arr torquesExternal_real(robot_state.tau_ext_hat_filtered.begin(), robot_state.tau_ext_hat_filtered.size(), false);
-    arr torques_real(robot_state.tau_J.begin(), robot_state.tau_J.size(), false);
-
-    qDotFilter = qDotFilterAlpha * qDotFilter + (1.-qDotFilterAlpha) * qDot_real;
-    qDot_real = qDotFilter;
-
-    //-- get real time
-    //ctrlTime += .001; //HARD CODED: 1kHz
-    //ctrlTime = rai::realTime();
+    for(uint i=0;i<7;i++){
+      ws.qDotFilter[i] = qDotFilterAlpha * ws.qDotFilter[i] + (1.-qDotFilterAlpha) * robot_state.dq[i];
+      ws.q[i] = robot_state.q[i];
+      ws.qDot[i] = ws.qDotFilter[i];
+      ws.tauExternal[i] = robot_state.tau_ext_hat_filtered[i];
+      ws.tauJ[i] = robot_state.tau_J[i];
+    }
 
     //-- publish state & INCREMENT CTRL TIME
-    arr state_q_real, state_qDot_real;
     {
-      auto stateSet = state.set();
-      if(robotID==0){ // if this is the lead robot, increment ctrlTime if no stall
-        if(!stateSet->stall) stateSet->ctrlTime += .001; //HARD CODED: 1kHz
-        else stateSet->stall--;
-      }
-      ctrlTime = stateSet->ctrlTime;
-      for(uint i=0;i<7;i++){
-        stateSet->q.elem(qIndices(i)) = q_real.elem(i);
-        stateSet->qDot.elem(qIndices(i)) = qDot_real.elem(i);
-        stateSet->tauExternalIntegral.elem(qIndices(i)) += torquesExternal_real.elem(i);
-      }
-      stateSet->tauExternalCount++;
-      state_q_real = stateSet->q;
-      state_qDot_real = stateSet->qDot;
+      rai::LatencyScope lockWait(timing.lockWait);
+      ctrlTime = channel->tick(channelSlot, duration.toSec()); //shared clock: same ctrlTime for the same tick of both arms
+      channel->publishState(channelSlot, ws.q.data(), ws.qDot.data(), ws.tauExternal.data());
+      double t;
+      channel->getState(ws.state_q, ws.state_qDot, t); //full state (all robots) for the reference callback
+      if(mirrorState) channel->mirrorState(state);
     }
 
     //-- get current ctrl command
-    arr q_ref, qDot_ref, qDDot_ref, Kp_ref, Kd_ref, P_compliance; // TODO Kp, Kd and also read out the correct indices
     rai::ControlType controlType;
     {
-      auto cmdGet = cmd.get();
+      const rai::CtrlCmdMsg& cmdGet = channel->readCmd(channelSlot);
 
-      controlType = cmdGet->controlType;
+      controlType = cmdGet.controlType;
 
       //get commanded reference from the reference callback (e.g., sampling a spline reference)
-      arr cmd_q_ref, cmd_qDot_ref, cmd_qDDot_ref;
-      if(cmdGet->ref){
-        cmdGet->ref->getReference(cmd_q_ref, cmd_qDot_ref, cmd_qDDot_ref, state_q_real, state_qDot_real, ctrlTime);
-        CHECK(!cmd_q_ref.N || cmd_q_ref.N > qIndices_max, "");
-        CHECK(!cmd_qDot_ref.N || cmd_qDot_ref.N > qIndices_max, "");
-        CHECK(!cmd_qDDot_ref.N || cmd_qDDot_ref.N > qIndices_max, "");
-      }
+      //(the callback is expected to write all three outputs; N=0 means 'no reference')
+      ws.ref.clearReferences();
+      if(cmdGet.ref){
+        {
+          rai::LatencyScope refTime(timing.reference);
+          cmdGet.ref->getReference(ws.cmd_q_ref, ws.cmd_qDot_ref, ws.cmd_qDDot_ref, ws.state_q, ws.state_qDot, ctrlTime);
+        }
+        CHECK(!ws.cmd_q_ref.N || ws.cmd_q_ref.N > qIndices_max, "");
+        CHECK(!ws.cmd_qDot_ref.N || ws.cmd_qDot_ref.N > qIndices_max, "");
+        CHECK(!ws.cmd_qDDot_ref.N || ws.cmd_qDDot_ref.N > qIndices_max, "");
 
-      //pick qIndices for this particular robot
-      if(cmd_q_ref.N){
-        q_ref.resize(7);
-        for(uint i=0; i<7; i++) q_ref.elem(i) = cmd_q_ref.elem(qIndices(i));
-      }
-      if(cmd_qDot_ref.N){
-        qDot_ref.resize(7);
-        for(uint i=0; i<7; i++) qDot_ref.elem(i) = cmd_qDot_ref.elem(qIndices(i));
-      }
-      if(cmd_qDDot_ref.N){
-        qDDot_ref.resize(7);
-        for(uint i=0; i<7; i++) qDDot_ref.elem(i) = cmd_qDDot_ref.elem(qIndices(i));
-      }
-      if(cmdGet->Kp.d0 >= 7 && cmdGet->Kp.d1 >=7 && cmdGet->Kp.d0 == cmdGet->Kp.d1){
-        Kp_ref.resize(7, 7);
-        for(uint i=0; i<7; i++) for(uint j=0; j<7; j++) Kp_ref(i, j) = cmdGet->Kp(qIndices(i), qIndices(j));
-      }
-      if(cmdGet->Kd.d0 >= 7 && cmdGet->Kd.d1 >=7 && cmdGet->Kd.d0 == cmdGet->Kd.d1){
-        Kd_ref.resize(7, 7);
-        for(uint i=0; i<7; i++) for(uint j=0; j<7; j++) Kd_ref(i, j) = cmdGet->Kd(qIndices(i), qIndices(j));
+        //pick qIndices for this particular robot
+        ws.ref.pickReferences(ws.cmd_q_ref, ws.cmd_qDot_ref, ws.cmd_qDDot_ref, qIndices);
       }
-      if(cmdGet->P_compliance.N) {
-        P_compliance.resize(7,7);
-        for(uint i=0; i<7; i++) for(uint j=0; j<7; j++) P_compliance(i,j) = cmdGet->P_compliance(qIndices(i), qIndices(j));
-      }
-
+      ws.ref.pickGains(cmdGet, qIndices);
     }
 
     requiresInitialization=false;
 
     //-- cap the reference difference
-    if(q_ref.N==7){
-      double err = length(q_ref - q_real);
-      if(P_compliance.N){
-        arr del = q_ref - q_real;
-        err = ::sqrt(scalarProduct(del, P_compliance*del));
-      }
+    if(ws.ref.has_q){
+      double err = Workspace::K::trackingError(ws.ref, ws.q);
       if(err>.05){ //if(err>.02){ //stall!
-        state.set()->stall = 2; //no progress in reference time! for at least 2 iterations (to ensure continuous stall with multiple threads)
+        channel->requestStall(channelSlot, 2); //no progress in reference time (depending on policy) for at least 2 ticks
         cout <<"STALLING - step:" <<steps <<" err: " <<err <<endl;
       }
     }
 
-    //-- grab dynamics
-    arr M_org(model.mass(robot_state).begin(), 49, false);
-    M_org.reshape(7,7);
-    arr C_org(model.coriolis(robot_state).begin(), 7, false);
-    arr G_org(model.gravity(robot_state).begin(), 7, false);
+    //-- dynamics model: evaluated on demand, at most once per tick
+    rai::LazyDynamics<7, typename B::Model, typename B::RobotState> dyn(model, robot_state, ws.M, ws.C, ws.G, &timing.dynamics);
 
     //-- compute torques from control message depending on the control type
-    arr u;
-
-    if(controlType == rai::ControlType::configRefs) { //default: PD for given references
-      //check for compliance objective
-      if(P_compliance.N){
-        if(!(P_compliance.nd==2 && P_compliance.d0==7 && P_compliance.d1==7)){
-          cerr << "FRANKA: inconsistent ctrl P_compliance message" << endl;
-          P_compliance.clear();
-        }
-      }
-
-      //-- compute desired torques
-      arr Kp(7), Kd(7);
-      CHECK_EQ(Kp_freq.N, 7,"");
-      CHECK_EQ(Kd_ratio.N, 7,"");
-      for(uint i=0;i<7;i++){
-        double freq = Kp_freq.elem(i);
-        Kp.elem(i) = freq*freq;
-        Kd.elem(i) = 2.*Kd_ratio.elem(i)*freq;
-      }
-
-      if(P_compliance.N){
-        Kp = P_compliance * (Kp % P_compliance);
-      }else{
-        Kp = diag(Kp);
-      }
-
-      //-- initialize zero torques
-      u.resize(7).setZero();
-
-      //-- add feedback term
-      if(q_ref.N==7){
-        u += Kp * (q_ref - q_real);
-      }
-      if(qDot_ref.N==7){
-        u += Kd % (qDot_ref - qDot_real);
-      }
-
-      //-- add feedforward term
-      if(qDDot_ref.N==7 && absMax(qDDot_ref)>0.){
-        arr M = M_org; // + diag(arr{0.4, 0.3, 0.3, 0.4, 0.4, 0.4, 0.2));
-        u += M*qDDot_ref;
-      }
-
-      //-- add friction term
-      if(friction.N==7 && qDot_ref.N==7){
-        double velThresh=1e-3;
-        for(uint i=0;i<7;i++){
-          double coeff = qDot_ref.elem(i)/velThresh;
-          if(coeff>1.) coeff=1.;
-          if(coeff<-1.) coeff=-1.;
-          u.elem(i) += coeff*friction.elem(i);
-//          if(qDot_ref.elem(i)>1e-4) u.elem(i) += friction.elem(i);
-//          if(qDot_ref.elem(i)<-1e-4) u.elem(i) -= friction.elem(i);
-        }
-      }
-
-      //-- project with compliance
-      if(P_compliance.N) u = P_compliance * u;
+    uint dynBaseline=3; //evaluations of the former non-lazy path (mass, coriolis, gravity each tick; +mass for projectedAcc)
+    if(controlType == rai::ControlType::configRefs) { //default: PD for given references (+feedforward, friction, compliance)
+      const Workspace::K::Mat* M = Workspace::K::needsMass(ws.ref) ? &dyn.M() : 0;
+      Workspace::K::configRefs(ws.u, ws.ref, ws.q, ws.qDot, ws.Kp, ws.Kd, M, (friction.N==7 ? friction.p : 0));
 
     } else if(controlType == rai::ControlType::projectedAcc) { // projected Kp, Kd and u_b term for projected operational space control
-      CHECK_EQ(Kp_ref.nd, 2, "")
-      CHECK_EQ(Kp_ref.d0, 7, "")
-      CHECK_EQ(Kp_ref.d1, 7, "")
-      CHECK_EQ(Kd_ref.nd, 2, "")
-      CHECK_EQ(Kd_ref.d0, 7, "")
-      CHECK_EQ(Kd_ref.d1, 7, "")
-      CHECK_EQ(qDDot_ref.N, 7, "")
-
-      arr M;
-      M.setCarray(model.mass(robot_state).begin(), 49);
-      M.reshape(7,7);
-
-#if 0
-      c++;
-      if(c%10 == 0) {
-        cout << M << endl << endl;
-      }
-#endif
-
-
-#if 0
-      M(4,4) = 0.2;
-      M(5,5) = 0.2;../04-trivialCtrl/retired.cpp
-      M(6,6) = 0.1;
-#else
-      arr MDiag = diag(arr{0.4, 0.3, 0.3, 0.4, 0.4, 0.4, 0.2});
-      M = M + MDiag;
-#endif
-
-      Kp_ref = M*Kp_ref;
-      Kd_ref = M*Kd_ref;
-      qDDot_ref = M*qDDot_ref;
-
-      u = qDDot_ref - Kp_ref*q_real - Kd_ref*qDot_real;
-
-      //u(5) *= 2.0;
+      CHECK(ws.ref.has_Kp && ws.ref.has_Kd, "projectedAcc requires 7x7 Kp and Kd references");
+      CHECK(ws.ref.has_qDDot, "projectedAcc requires a qDDot reference");
 
-      //cout << u << endl;
+      dynBaseline++;
+      Workspace::K::Mat M = dyn.M();
+      const double MDiag[7] = {0.4, 0.3, 0.3, 0.4, 0.4, 0.4, 0.2};
+      for(uint i=0;i<7;i++) M[7*i+i] += MDiag[i];
+      Workspace::K::projectedAcc(ws.u, ws.ref, ws.q, ws.qDot, M);
 
       //u *= 0.0; // useful for testing new stuff without braking the robot
+    } else {
+      ws.u.fill(0.);
     }
 
     //-- filter torques
-    if(u.N==lastTorque.N){
-//      double alpha=.5;
-//      u = alpha*u + (1.-alpha)*lastTorque;
-      lastTorque = u;
-    }
+    ws.lastTorque = ws.u;
 
     //-- data log?
     if(writeData>0 && !(steps%10)){
-      if(!dataFile.is_open()) dataFile.open(STRING("z.panda"<<robotID <<".dat"));
-      dataFile <<ctrlTime <<' '; //single number
-      q_real.modRaw().write(dataFile); //7
-      q_ref.modRaw().write(dataFile); //7
-      if(writeData>1){
-        qDot_real.modRaw().write(dataFile); //7
-        qDot_ref.modRaw().write(dataFile); //7
-        u.modRaw().write(dataFile); //7
-        torques_real.modRaw().write(dataFile); //7
-        G_org.modRaw().write(dataFile); //7-vector gravity
-        C_org.modRaw().write(dataFile); //7-vector coriolis
-        qDDot_ref.modRaw().write(dataFile);
-      }
-      if(writeData>2){
-        M_org.write(dataFile, " ", " ", "  "); //7x7 inertia matrix
-      }
-      dataFile <<endl;
+      rai::TelemetryRecorder::Record rec = telemetry->begin();
+      rec(ctrlTime)
+          (ws.q.data(), 7)
+          (ws.ref.has_q ? ws.ref.q.data() : 0, 7)
+          (ws.qDot.data(), 7)
+          (ws.ref.has_qDot ? ws.ref.qDot.data() : 0, 7)
+          (ws.u.data(), 7)
+          (ws.tauJ.data(), 7)
+          (writeData>1 ? dyn.G().data() : 0, 7) //dynamics only logged (and evaluated for it) at higher levels
+          (writeData>1 ? dyn.C().data() : 0, 7)
+          (ws.ref.has_qDDot ? ws.ref.qDDot.data() : 0, 7)
+          (writeData>2 ? dyn.M().data() : 0, 49); //7x7 inertia matrix, row-major
+      telemetry->commit(rec);
     }
+    timing.dynamicsSkipped.fetch_add(dynBaseline - dyn.evaluations(), std::memory_order_relaxed);
 
     //-- send torques
-    std::array<double, 7> u_array = {0., 0., 0., 0., 0., 0., 0.};
-    for(uint i=0;i<7;i++) u_array[i]= u.elem(i);
+    timing.tickEnd();
     if(stop){
-      return franka::MotionFinished(franka::Torques(u_array));
+      return B::motionFinished(typename B::Torques(ws.u));
     }
-    return franka::Torques(u_array);
+    return typename B::Torques(ws.u);
   };
 
   //start real-time control loop
-  //cout <<"HERE" <<endl;
-
   try {
     robot.control(torque_control_callback, true, 2000.);
-  } catch (franka::Exception const& e) {
+  } catch (typename B::Exception const& e) {
     std::cout << e.what() << std::endl;
   }
   LOG(0) <<"EXIT FRANKA CONTROL LOOP";
+  if(rai::rtAllocCount()) LOG(-1) <<"there were " <<rai::rtAllocCount() <<" heap allocations within real-time callbacks (total, all threads)";
 }
-
-#else //RAI_FRANKA
-
-FrankaThread::~FrankaThread(){ NICO }
-void FrankaThread::init(uint _robotID, const uintA& _qIndices) { NICO }
-void FrankaThread::step(){ NICO }
-
-#endif
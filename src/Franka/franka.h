@@ -4,11 +4,15 @@
 #include <Core/thread.h>
 #include <Control/ctrlMsg.h>
 #include <Control/CtrlMsgs.h>
+#include <RealTime/ctrlKernels.h>
 
+struct CtrlChannel;
+namespace rai{ struct TelemetryRecorder; }
 
 struct FrankaThread : rai::RobotAbstraction, Thread{
   FrankaThread(uint robotID=0, const uintA& _qIndices={0, 1, 2, 3, 4, 5, 6}) : Thread("FrankaThread"){ init(robotID, _qIndices); }
-  FrankaThread(uint robotID, const uintA& _qIndices, const Var<rai::CtrlCmdMsg>& _cmd, const Var<rai::CtrlStateMsg>& _state) : RobotAbstraction(_cmd, _state), Thread("FrankaThread"){ init(robotID, _qIndices); }
+  FrankaThread(uint robotID, const uintA& _qIndices, const Var<rai::CtrlCmdMsg>& _cmd, const Var<rai::CtrlStateMsg>& _state, const std::shared_ptr<CtrlChannel>& _channel={})
+    : RobotAbstraction(_cmd, _state), Thread("FrankaThread"), channel(_channel){ init(robotID, _qIndices); }
   ~FrankaThread();
 
 private:
@@ -18,15 +22,43 @@ private:
   arr Kp_freq, Kd_ratio; //read from rai.cfg
   arr friction;
 
-  const char* ipAddress;
+  rai::String ipAddress; //Franka/ipAddresses(robotID)
+  bool useFake=false; //Franka/fake: run against the in-process fakeFranka::Robot instead of libfranka
 
   uintA qIndices;
   uint qIndices_max=0;
 
   uint steps=0;
-  ofstream dataFile;
+  std::shared_ptr<rai::TelemetryRecorder> telemetry; //writeData>0: binary log z.panda<ID>.tlm, set up before the loop, written off-thread
   double ctrlTime=0.;
 
+  //-- lock-free exchange with the user side; if none is given (standalone use), an own channel
+  //   is attached to cmd and mirrored into state each tick (legacy, blocking)
+  std::shared_ptr<CtrlChannel> channel;
+  uint channelSlot=0;
+  bool mirrorState=false;
+
+  //-- preallocated workspace of the 1kHz torque callback: everything that is computed per tick
+  //   lives here with fixed capacity, so that the callback itself does not allocate
+  struct Workspace{
+    typedef rai::CtrlKernel<7> K;
+
+    K::Vec q, qDot, qDotFilter, tauExternal, tauJ; //real state
+    K::Refs ref;                                   //references, picked from the full-size cmd at qIndices
+
+    K::Vec Kp, Kd;  //diagonal gains (from Kp_freq and Kd_ratio; set once in init)
+    K::Mat M;       //mass matrix
+    K::Vec C, G;    //coriolis, gravity
+    K::Vec u, lastTorque;
+
+    arr state_q, state_qDot;                   //full-size state, passed to the reference callback
+    arr cmd_q_ref, cmd_qDot_ref, cmd_qDDot_ref; //full-size reference, filled by the reference callback
+  } ws;
+
   void init(uint _robotID, const uintA& _qIndices);
   void step();
+  template<class Backend> void controlLoop(); //the libfranka-style torque control loop, for a real or fake robot
 };
+
+/// ip address of the robotID-th arm (rai.cfg Franka/ipAddresses, one per arm) -- its gripper is addressed through it
+rai::String frankaIpAddress(uint robotID);
@@ -11,11 +11,12 @@ enum PixelLabel : byte { PL_unexplained=0x00, PL_nosignal=0x01, PL_noise=0x02, P
                          PL_closeToObject=0xc0,
                          PL_max=0xff};
 
-inline uintA franka_getJointIndices(const rai::Configuration& C, char L_or_R){
+/// qIndices of the 7 joints '<prefix>_panda_joint<i>' of one arm
+inline uintA franka_getJointIndices(const rai::Configuration& C, const char* prefix){
   CHECK(C._state_indexedJoints_areGood , "need to ensure_q (indexed joints) before!");
   StringA jointNames;
   for(uint i=1;i<=7;i++){
-    jointNames.append(STRING(L_or_R <<"_panda_joint" <<i));
+    jointNames.append(STRING(prefix <<"_panda_joint" <<i));
   }
   FrameL joints = C.getFrames(jointNames);
   uintA qIndices(7);
@@ -23,6 +24,10 @@ inline uintA franka_getJointIndices(const rai::Configuration& C, char L_or_R){
   return qIndices;
 }
 
+inline uintA franka_getJointIndices(const rai::Configuration& C, char L_or_R){
+  return franka_getJointIndices(C, STRING(L_or_R).p);
+}
+
 
 inline byteA franka_getFrameMaskMap(const rai::Configuration& K){
   byteA frameMaskMap(K.frames.N); //map each frame in the image to a mask byte (here just 0 or 0xff)
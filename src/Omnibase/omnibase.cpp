@@ -1,5 +1,9 @@
 #include "omnibase.h"
 #include "SimplexMotion.h"
+#include <RealTime/ctrlChannel.h>
+#include <RealTime/rtConfig.h>
+#include <RealTime/timingStats.h>
+#include <RealTime/ctrlKernels.h>
 
 #ifdef RAI_OMNIBASE
 
@@ -118,6 +122,15 @@ void OmnibaseThread::init(uint _robotID, const uintA& _qIndices) {
   //-- get robot address
   address = rai::getParameter<rai::String>("Omnibase/address", "172.16.0.2");
 
+  //-- state/command exchange with the user side
+  if(!channel){
+    channel = make_shared<CtrlChannel>(qIndices_max+1);
+    CtrlChannel::attach(channel, cmd);
+    mirrorState = true;
+  }
+  channelSlot = channel->registerRobot(qIndices, STRING("OmnibaseThread" <<robotID), metronome.ticInterval, metronome.ticInterval,
+                                      CtrlChannel::stallPolicy(rai::getParameter<rai::String>("Omnibase/stallPolicy", "holdAll")));
+
   //-- start thread and wait for first state signal
   LOG(0) <<"launching Omnibase " <<robotID <<" at " <<address;
 
@@ -126,6 +139,9 @@ void OmnibaseThread::init(uint _robotID, const uintA& _qIndices) {
 }
 
 void OmnibaseThread::open(){
+  // scheduling, pinning, memory locking of this (the control) thread
+  rai::applyRtConfig(rai::RtThreadConfig::fromParams("Omnibase", robotID), STRING("OmnibaseThread" <<robotID));
+
   // connect to robot
    robot = make_shared<OmnibaseController>(address);
 
@@ -133,22 +149,13 @@ void OmnibaseThread::open(){
    arr q_real, qDot_real;
    robot->getState(q_real, qDot_real);
 
-   auto stateSet = state.set();
-
-   //ensure state variables have sufficient size
-   while(stateSet->q.N<=qIndices_max) stateSet->q.append(0.);
-   while(stateSet->qDot.N<=qIndices_max) stateSet->qDot.append(0.);
-   while(stateSet->tauExternalIntegral.N<=qIndices_max) stateSet->tauExternalIntegral.append(0.);
-
-   for(uint i=0; i<3; i++){
-     stateSet->q.elem(qIndices(i)) = q_real(i);
-     stateSet->qDot.elem(qIndices(i)) = qDot_real(i);
-     stateSet->tauExternalIntegral.elem(qIndices(i)) = 0.;
-     stateSet->tauExternalCount=0;
-   }
+   channel->publishState(channelSlot, q_real.p, qDot_real.p);
+   if(mirrorState) channel->mirrorState(state);
 }
 
 void OmnibaseThread::step(){
+  rai::LoopTiming& timing = channel->timing(channelSlot);
+  timing.tickBegin();
   steps++;
 
   //-- get current state from robot
@@ -160,107 +167,67 @@ void OmnibaseThread::step(){
   //-- publish state & INCREMENT CTRL TIME
   arr state_q_real, state_qDot_real;
   {
-    auto stateSet = state.set();
-    if(robotID==0){ // if this is the lead robot, increment ctrlTime if no stall
-      if(!stateSet->stall) stateSet->ctrlTime += metronome.ticInterval;
-      else stateSet->stall--;
-    }
-    ctrlTime = stateSet->ctrlTime;
-    for(uint i=0;i<3;i++){
-      stateSet->q.elem(qIndices(i)) = q_real.elem(i);
-      stateSet->qDot.elem(qIndices(i)) = qDot_real.elem(i);
-    }
-    state_q_real = stateSet->q;
-    state_qDot_real = stateSet->qDot;
+    rai::LatencyScope lockWait(timing.lockWait);
+    ctrlTime = channel->tick(channelSlot, metronome.ticInterval);
+    channel->publishState(channelSlot, q_real.p, qDot_real.p);
+    double t;
+    channel->getState(state_q_real, state_qDot_real, t);
+    if(mirrorState) channel->mirrorState(state);
   }
 
   //-- get current ctrl command
-  arr q_ref, qDot_ref, qDDot_ref, Kp_ref, Kd_ref, P_compliance;
+  typedef rai::CtrlKernel<3> K;
+  K::Refs ref;
   {
-    auto cmdGet = cmd.get();
+    const rai::CtrlCmdMsg& cmdGet = channel->readCmd(channelSlot);
 
     //get commanded reference from the reference callback (e.g., sampling a spline reference)
     arr cmd_q_ref, cmd_qDot_ref, cmd_qDDot_ref;
-    if(cmdGet->ref){
-      cmdGet->ref->getReference(cmd_q_ref, cmd_qDot_ref, cmd_qDDot_ref, state_q_real, state_qDot_real, ctrlTime);
+    if(cmdGet.ref){
+      rai::LatencyScope refTime(timing.reference);
+      cmdGet.ref->getReference(cmd_q_ref, cmd_qDot_ref, cmd_qDDot_ref, state_q_real, state_qDot_real, ctrlTime);
       CHECK(!cmd_q_ref.N || cmd_q_ref.N > qIndices_max, "");
       CHECK(!cmd_qDot_ref.N || cmd_qDot_ref.N > qIndices_max, "");
       CHECK(!cmd_qDDot_ref.N || cmd_qDDot_ref.N > qIndices_max, "");
     }
 
     //pick qIndices for this particular robot
-    if(cmd_q_ref.N){
-      q_ref.resize(3);
-      for(uint i=0; i<3; i++) q_ref.elem(i) = cmd_q_ref.elem(qIndices(i));
-    }
-    if(cmd_qDot_ref.N){
-      qDot_ref.resize(3);
-      for(uint i=0; i<3; i++) qDot_ref.elem(i) = cmd_qDot_ref.elem(qIndices(i));
-    }
-    if(cmd_qDDot_ref.N){
-      qDDot_ref.resize(3);
-      for(uint i=0; i<3; i++) qDDot_ref.elem(i) = cmd_qDDot_ref.elem(qIndices(i));
-    }
-    if(cmdGet->Kp.d0 >= 3 && cmdGet->Kp.d1 >=3 && cmdGet->Kp.d0 == cmdGet->Kp.d1){
-      Kp_ref.resize(3, 3);
-      for(uint i=0; i<3; i++) for(uint j=0; j<3; j++) Kp_ref(i, j) = cmdGet->Kp(qIndices(i), qIndices(j));
-    }
-    if(cmdGet->Kd.d0 >= 3 && cmdGet->Kd.d1 >=3 && cmdGet->Kd.d0 == cmdGet->Kd.d1){
-      Kd_ref.resize(3, 3);
-      for(uint i=0; i<3; i++) for(uint j=0; j<3; j++) Kd_ref(i, j) = cmdGet->Kd(qIndices(i), qIndices(j));
-    }
-    if(cmdGet->P_compliance.N) {
-      P_compliance.resize(3,3);
-      for(uint i=0; i<3; i++) for(uint j=0; j<3; j++) P_compliance(i,j) = cmdGet->P_compliance(qIndices(i), qIndices(j));
-    }
-
+    ref.pickReferences(cmd_q_ref, cmd_qDot_ref, cmd_qDDot_ref, qIndices);
+    ref.pickGains(cmdGet, qIndices);
   }
 
+  K::Vec q, qDot;
+  for(uint i=0;i<3;i++){ q[i] = q_real.elem(i); qDot[i] = qDot_real.elem(i); }
+
   //-- cap the reference difference
-  if(q_ref.N==3){
-    double err = length(q_ref - q_real);
-    if(P_compliance.N){
-      arr del = q_ref - q_real;
-      err = ::sqrt(scalarProduct(del, P_compliance*del));
-    }
+  if(ref.has_q){
+    double err = K::trackingError(ref, q);
     if(err>.05){ //stall!
-      state.set()->stall = 2; //no progress in reference time! for at least 2 iterations (to ensure continuous stall with multiple threads)
+      channel->requestStall(channelSlot, 2); //no progress in reference time (depending on policy) for at least 2 ticks
       cout <<"STALLING - step:" <<steps <<" err: " <<err <<endl;
     }
   }
 
-  //-- compute torques from control message depending on the control type
-  arr u;
-
-  //-- compute desired torques
-  arr Kp(3), Kd(3);
+  //-- compute desired torques: PD (+compliance), no feedforward or friction
+  K::Vec Kp, Kd;
   CHECK_EQ(Kp_freq.N, 3,"");
   CHECK_EQ(Kd_ratio.N, 3,"");
   for(uint i=0;i<3;i++){
     double freq = Kp_freq.elem(i);
-    Kp.elem(i) = freq*freq;
-    Kd.elem(i) = 2.*Kd_ratio.elem(i)*freq;
+    Kp[i] = freq*freq;
+    Kd[i] = 2.*Kd_ratio.elem(i)*freq;
   }
 
-  if(P_compliance.N){
-    Kp = P_compliance * (Kp % P_compliance);
-  }else{
-    Kp = diag(Kp);
-  }
-
-  //-- initialize zero torques
-  u.resize(3).setZero();
-
-  //-- add feedback term
-  if(q_ref.N==3){
-    u += Kp * (q_ref - q_real);
-  }
-  if(qDot_ref.N==3){
-    u += Kd % (qDot_ref - qDot_real);
-  }
+  K::Vec uVec;
+  K::configRefs(uVec, ref, q, qDot, Kp, Kd);
+  arr u;
+  u.setCarray(uVec.data(), 3);
 
-  //-- project with compliance
-  if(P_compliance.N) u = P_compliance * u;
+  //-- (legacy names for the data log)
+  arr q_ref, qDot_ref, qDDot_ref;
+  if(ref.has_q) q_ref.setCarray(ref.q.data(), 3);
+  if(ref.has_qDot) qDot_ref.setCarray(ref.qDot.data(), 3);
+  if(ref.has_qDDot) qDDot_ref.setCarray(ref.qDDot.data(), 3);
 
   //-- data log?
   if(writeData>0 && !(steps%1)){
@@ -279,6 +246,7 @@ void OmnibaseThread::step(){
 
   //-- send torques
   robot->setTorques(u);
+  timing.tickEnd();
 }
 
 void OmnibaseThread::close(){
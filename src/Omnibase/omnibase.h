@@ -6,9 +6,11 @@
 #include <Control/CtrlMsgs.h>
 
 struct OmnibaseController;
+struct CtrlChannel;
 
 struct OmnibaseThread : rai::RobotAbstraction, Thread {
-  OmnibaseThread(uint robotID, const uintA& _qIndices, const Var<rai::CtrlCmdMsg>& _cmd, const Var<rai::CtrlStateMsg>& _state) : RobotAbstraction(_cmd, _state), Thread("OmnibaseThread", .01){ init(robotID, _qIndices); }
+  OmnibaseThread(uint robotID, const uintA& _qIndices, const Var<rai::CtrlCmdMsg>& _cmd, const Var<rai::CtrlStateMsg>& _state, const std::shared_ptr<CtrlChannel>& _channel={})
+    : RobotAbstraction(_cmd, _state), Thread("OmnibaseThread", .01), channel(_channel){ init(robotID, _qIndices); }
   ~OmnibaseThread();
 
 private:
@@ -25,6 +27,10 @@ private:
 
   std::shared_ptr<OmnibaseController> robot;
 
+  std::shared_ptr<CtrlChannel> channel; //own channel (mirrored into state) if none is given
+  uint channelSlot=0;
+  bool mirrorState=false;
+
 
   void init(uint _robotID, const uintA& _qIndices);
   void open();
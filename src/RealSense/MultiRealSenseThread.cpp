@@ -1,5 +1,7 @@
 #include "MultiRealSenseThread.h"
 
+#include <RealTime/rtConfig.h>
+
 #ifdef RAI_REALSENSE
 
 #include <librealsense2/rs.hpp>
@@ -175,6 +177,7 @@ uint MultiRealSenseThread::getNumberOfCameras() {
 }
 
 void MultiRealSenseThread::open() {
+  rai::applyNonRtAffinity("MultiRealSenseThread");
   rs2::log_to_console(RS2_LOG_SEVERITY_ERROR);
 
   for(const auto& cameraName : cameraNames) {
@@ -1,5 +1,7 @@
 #include "RealSenseThread.h"
 
+#include <RealTime/rtConfig.h>
+
 #ifdef RAI_REALSENSE
 
 #include <librealsense2/rs.hpp>
@@ -45,6 +47,8 @@ void RealSenseThread::getImageAndDepth(byteA& _image, floatA& _depth){
 }
 
 void RealSenseThread::open(){
+  rai::applyNonRtAffinity("RealSenseThread");
+
   bool longCable = rai::getParameter<bool>("RealSense/longCable", false);
   int resolution = rai::getParameter<int>("RealSense/resolution", 640);
   bool alignToDepth = rai::getParameter<bool>("RealSense/alignToDepth", true);
@@ -0,0 +1,54 @@
+#include "allocGuard.h"
+
+#ifdef RAI_RT_ALLOC_GUARD
+
+#include <atomic>
+#include <cstddef>
+
+//glibc's actual allocator entry points, which we forward to
+extern "C" {
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t n, size_t size);
+  void* __libc_realloc(void* ptr, size_t size);
+}
+
+//initial-exec TLS: must not itself call malloc on first access
+static thread_local int rtScopeDepth __attribute__((tls_model("initial-exec"))) = 0;
+static thread_local uint64_t rtCount_thisThread __attribute__((tls_model("initial-exec"))) = 0;
+static std::atomic<uint64_t> rtCount_total(0);
+
+static inline void countAlloc(){
+  if(rtScopeDepth>0){
+    rtCount_thisThread++;
+    rtCount_total.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+extern "C" void* malloc(size_t size){
+  countAlloc();
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size){
+  countAlloc();
+  return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size){
+  countAlloc();
+  return __libc_realloc(ptr, size);
+}
+
+namespace rai {
+
+RtAllocScope::RtAllocScope(){ rtScopeDepth++; }
+
+RtAllocScope::~RtAllocScope(){ rtScopeDepth--; }
+
+uint64_t rtAllocCount(){ return rtCount_total.load(std::memory_order_relaxed); }
+
+uint64_t rtAllocCount_thisThread(){ return rtCount_thisThread; }
+
+} //namespace
+
+#endif //RAI_RT_ALLOC_GUARD
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+//===========================================================================
+//
+// debug guard against heap allocations on real-time threads
+//
+// With RAI_RT_ALLOC_GUARD defined (cmake -DUSE_RT_ALLOC_GUARD=ON, or a Debug
+// build), malloc/calloc/realloc are interposed and every allocation made while
+// an RtAllocScope is alive on the calling thread is counted. Without the flag,
+// all of this compiles to nothing.
+//
+// Note: the interposition only takes effect if the library is linked into the
+// executable (not when dlopen'ed RTLD_LOCAL, e.g. from python).
+//
+
+namespace rai {
+
+#ifdef RAI_RT_ALLOC_GUARD
+
+/// marks the calling thread as real-time while in scope (nestable)
+struct RtAllocScope {
+  RtAllocScope();
+  ~RtAllocScope();
+};
+
+/// number of allocations counted within RtAllocScopes of all threads
+uint64_t rtAllocCount();
+
+/// number of allocations counted within RtAllocScopes of the calling thread
+uint64_t rtAllocCount_thisThread();
+
+#else
+
+struct RtAllocScope { RtAllocScope(){} ~RtAllocScope(){} };
+inline uint64_t rtAllocCount(){ return 0; }
+inline uint64_t rtAllocCount_thisThread(){ return 0; }
+
+#endif
+
+} //namespace
@@ -0,0 +1,443 @@
+#include "ctrlChannel.h"
+
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+CtrlChannel::CtrlChannel(uint nJoints)
+  : ctrlTime(0.), revision(0), wakeTime(std::numeric_limits<double>::infinity()), nSlices(0){
+  q0.resize(nJoints).setZero();
+  for(uint i=0;i<clockHistory;i++) clock.time[i]=0.;
+}
+
+CtrlChannel::~CtrlChannel(){
+}
+
+void CtrlChannel::attach(const std::shared_ptr<CtrlChannel>& channel, Var<rai::CtrlCmdMsg>& cmd){
+  channel->publishCmd(cmd.get());
+  //the callback is called within the writer's access -> reading the data directly is safe
+  cmd.addCallback([channel](Var_base* var){
+    Var_data<rai::CtrlCmdMsg>* x = dynamic_cast<Var_data<rai::CtrlCmdMsg>*>(var);
+    CHECK(x, "");
+    channel->publishCmd(x->data);
+  });
+}
+
+uint CtrlChannel::registerRobot(const uintA& qIndices, const char* name, double ctrlDt, double loopPeriod, StallPolicy stallPolicy){
+  std::lock_guard<std::mutex> lock(writeMutex);
+  uint slot = nSlices.load();
+  CHECK_LE(slot+1, (uint)maxRobots, "too many robots on one ctrl channel");
+  for(uint i:qIndices) CHECK_LE(i+1, q0.N, "robot joint index " <<i <<" exceeds channel dimension " <<q0.N);
+
+  auto s = std::make_shared<StateSlice>();
+  s->qIndices = qIndices;
+  CHECK_GE(ctrlDt, 1e-6, "");
+  s->stallPolicy = stallPolicy;
+  s->timing.name = name;
+  s->timing.nominalPeriod = (loopPeriod>0. ? loopPeriod : ctrlDt);
+  {
+    std::lock_guard<rai::SpinLock> clockLock(clock.lock);
+    if(!slot) clock.dt = ctrlDt; //the clock resolution is the period of the first robot
+    else if(fabs(ctrlDt-clock.dt)>1e-9) LOG(0) <<"robot '" <<name <<"' ticks at " <<ctrlDt <<"s on a clock of resolution " <<clock.dt <<"s";
+    s->epoch0 = s->epoch = clock.epoch; //join at the current clock epoch
+  }
+  s->q.resize(qIndices.N).setZero();
+  s->qDot.resize(qIndices.N).setZero();
+  s->tauExternalIntegral.resize(qIndices.N).setZero();
+  double historyLength = rai::getParameter<double>("bot/stateHistory", 5.);
+  s->history.init(qIndices.N, rai::MAX(16u, uint(::ceil(historyLength/ctrlDt))));
+  for(uint i=0;i<qIndices.N;i++) s->q.elem(i) = q0.elem(qIndices.elem(i));
+
+  auto c = std::make_shared<CmdSlot>();
+  c->buf.writeBuffer() = lastCmd;
+  c->buf.publish();
+  c->buf.update();
+
+  slices[slot] = s;
+  cmdSlots[slot] = c;
+  nSlices.store(slot+1, std::memory_order_release);
+  return slot;
+}
+
+CtrlChannel::StallPolicy CtrlChannel::stallPolicy(const char* name){
+  rai::String s(name);
+  if(s=="holdAll") return stallHoldAll;
+  if(s=="ignore") return stallIgnore;
+  HALT("unknown stall policy '" <<s <<"' (holdAll or ignore)");
+  return stallHoldAll;
+}
+
+double CtrlChannel::tick(uint slot, double dt){
+  StateSlice& s = *slices[slot];
+  s.hwTime += dt;
+  s.epoch = s.epoch0 + llround(s.hwTime/clock.dt);
+
+  double time;
+  {
+    std::lock_guard<rai::SpinLock> clockLock(clock.lock);
+    //extend the clock up to this robot's epoch (frozen while stalled)
+    while(clock.epoch < s.epoch){
+      double t = clock.time[clock.epoch%clockHistory];
+      clock.epoch++;
+      if(clock.epoch > clock.stallUntil) t += clock.dt;
+      clock.time[clock.epoch%clockHistory] = t;
+      ctrlTime.store(t, std::memory_order_release);
+    }
+    //the time of this robot's epoch (a robot lagging by more than the history gets the oldest kept)
+    int64_t e = rai::MAX<int64_t>(s.epoch, clock.epoch-clockHistory+1);
+    time = clock.time[e%clockHistory];
+  }
+  s.time = time;
+
+  //wake waiters whose time is reached (the fence pairs with the one in waitForTime: either we see
+  //their wakeTime, or they see our ctrlTime)
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if(ctrlTime.load(std::memory_order_relaxed) >= wakeTime.load(std::memory_order_relaxed)) tryNotify();
+  return time;
+}
+
+bool CtrlChannel::waitForTime(double t, double timeout){
+  std::unique_lock<std::mutex> lock(waitMutex);
+  uint64_t count = wakeCount;
+  //register t, if it is earlier than what others wait for
+  double w = wakeTime.load();
+  while(t<w && !wakeTime.compare_exchange_weak(w, t)){}
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if(getCtrlTime()>=t) return true;
+  waitCond.wait_for(lock, std::chrono::duration<double>(timeout), [&](){ return wakeCount!=count || getCtrlTime()>=t; });
+  return getCtrlTime()>=t;
+}
+
+void CtrlChannel::notify(){
+  wakeTime.store(std::numeric_limits<double>::infinity()); //woken waiters re-register
+  {
+    std::lock_guard<std::mutex> lock(waitMutex);
+    wakeCount++;
+  }
+  waitCond.notify_all();
+}
+
+void CtrlChannel::tryNotify(){
+  std::unique_lock<std::mutex> lock(waitMutex, std::try_to_lock);
+  if(!lock.owns_lock()){ //a waiter is registering right now: never wait for it in a robot thread --
+    wakeTime.store(-std::numeric_limits<double>::infinity()); //instead make the next tick retry
+    return;
+  }
+  wakeTime.store(std::numeric_limits<double>::infinity()); //woken waiters re-register
+  wakeCount++;
+  lock.unlock();
+  waitCond.notify_all();
+}
+
+void CtrlChannel::requestStall(uint slot, int epochs){
+  StateSlice& s = *slices[slot];
+  s.timing.stalls.fetch_add(1, std::memory_order_relaxed);
+  if(s.stallPolicy==stallHoldAll){
+    std::lock_guard<rai::SpinLock> clockLock(clock.lock);
+    clock.stallUntil = rai::MAX<int64_t>(clock.stallUntil, s.epoch+epochs);
+  }
+}
+
+void CtrlChannel::setTime(double time){
+  std::lock_guard<rai::SpinLock> clockLock(clock.lock);
+  for(uint i=0;i<clockHistory;i++) clock.time[i] = time; //also for robots reading a lagging epoch
+  clock.stallUntil = clock.epoch;
+  uint n = nSlices.load(std::memory_order_acquire);
+  for(uint k=0;k<n;k++) slices[k]->time = time;
+  ctrlTime.store(time, std::memory_order_release);
+}
+
+void CtrlChannel::publishState(uint slot, const double* q, const double* qDot, const double* tauExternal){
+  StateSlice& s = *slices[slot];
+  uint n = s.qIndices.N;
+  s.lock.writeBegin();
+  for(uint i=0;i<n;i++){
+    s.q.p[i] = q[i];
+    s.qDot.p[i] = qDot[i];
+  }
+  if(tauExternal){
+    for(uint i=0;i<n;i++) s.tauExternalIntegral.p[i] += tauExternal[i];
+    s.tauExternalCount++;
+  }
+  s.lock.writeEnd();
+  s.history.push(s.time, q, qDot, tauExternal);
+
+  //force monitors of this robot (a trigger wakes the waiters)
+  if(tauExternal && !forceMonitors.empty()){
+    bool triggered=false;
+    const ForceMonitorList* L = forceMonitors.acquire(slot);
+    if(L) for(const std::shared_ptr<ForceMonitor>& m:*L) if(m->slot==slot) triggered |= m->check(tauExternal, s.time);
+    forceMonitors.release(slot);
+    if(triggered) tryNotify(); //a busy waitMutex: the next tick retries
+  }
+  revision.fetch_add(1, std::memory_order_release);
+}
+
+const rai::CtrlCmdMsg& CtrlChannel::readCmd(uint slot){
+  CmdSlot& c = *cmdSlots[slot];
+  c.buf.update();
+  return c.buf.readBuffer();
+}
+
+void CtrlChannel::publishCmd(const rai::CtrlCmdMsg& cmd){
+  std::lock_guard<std::mutex> lock(writeMutex);
+  lastCmd = cmd;
+  uint n = nSlices.load(std::memory_order_acquire);
+  for(uint k=0;k<n;k++){
+    CmdSlot& c = *cmdSlots[k];
+    c.buf.writeBuffer() = cmd;
+    c.buf.publish();
+  }
+}
+
+void CtrlChannel::getState(arr& q, arr& qDot, double& _ctrlTime) const{
+  if(q.N!=q0.N) q.resize(q0.N);
+  if(qDot.N!=q0.N) qDot.resize(q0.N);
+  q = q0;
+  qDot.setZero();
+  uint n = nSlices.load(std::memory_order_acquire);
+  for(uint k=0;k<n;k++){
+    const StateSlice& s = *slices[k];
+    unsigned seq;
+    do{
+      seq = s.lock.readBegin();
+      for(uint i=0;i<s.qIndices.N;i++){
+        q.p[s.qIndices.p[i]] = s.q.p[i];
+        qDot.p[s.qIndices.p[i]] = s.qDot.p[i];
+      }
+    }while(s.lock.readRetry(seq));
+  }
+  _ctrlTime = getCtrlTime();
+}
+
+void CtrlChannel::scatterRow(double* X, const StateSlice& s, const double* row) const{
+  uint n = q0.N, m = s.qIndices.N;
+  for(uint i=0;i<m;i++){
+    uint j = s.qIndices.p[i];
+    X[1+j] = row[1+i];
+    X[1+n+j] = row[1+m+i];
+    X[1+2*n+j] = row[1+2*m+i];
+  }
+}
+
+bool CtrlChannel::getStateAt(double t, arr& q, arr& qDot, arr& tauExternal) const{
+  uint n = q0.N;
+  arr X(1+3*n), row;
+  X.setZero();
+  for(uint i=0;i<n;i++) X.p[1+i] = q0.p[i];
+  bool covered=true;
+  uint ns = nSlices.load(std::memory_order_acquire);
+  for(uint k=0;k<ns;k++){
+    const StateSlice& s = *slices[k];
+    if(!s.history.end()){ covered=false; continue; } //nothing published yet
+    row.resize(s.history.rowSize());
+    if(!s.history.sampleAt(t, row.p)) covered=false;
+    scatterRow(X.p, s, row.p);
+  }
+  if(!!q) q.setCarray(X.p+1, n);
+  if(!!qDot) qDot.setCarray(X.p+1+n, n);
+  if(!!tauExternal) tauExternal.setCarray(X.p+1+2*n, n);
+  return covered;
+}
+
+void CtrlChannel::getStateHistory(arr& X, double t0, double t1) const{
+  uint n = q0.N;
+  X.clear();
+  uint ns = nSlices.load(std::memory_order_acquire);
+  uint64_t next[maxRobots];
+  for(uint j=0;j<ns;j++){
+    const rai::StateRing& H = slices[j]->history;
+    if(!H.find(t0, next[j])) next[j] = H.begin();
+  }
+  arr rowX(1+3*n), tmp;
+  double tEnd = rai::MIN(t1, historyHorizon(ns, tmp));
+  while(mergedRow(rowX.p, next, ns, tEnd, tmp)){
+    if(rowX.p[0]<t0) continue;
+    X.append(rowX);
+  }
+  if(X.N) X.reshape(-1, 1+3*n);
+  else X.resize(0, 1+3*n);
+}
+
+double CtrlChannel::historyHorizon(uint ns, arr& tmp) const{
+  double horizon = std::numeric_limits<double>::infinity();
+  for(uint j=0;j<ns;j++){
+    const rai::StateRing& H = slices[j]->history;
+    uint64_t end = H.end();
+    if(!end) continue; //nothing published yet
+    tmp.resize(H.rowSize());
+    if(H.read(end-1, tmp.p) && tmp.p[0]<horizon) horizon = tmp.p[0];
+  }
+  return horizon;
+}
+
+bool CtrlChannel::mergedRow(double* X, uint64_t* next, uint ns, double tEnd, arr& tmp, uint64_t* dropped) const{
+  uint n = q0.N;
+  //-- the earliest next sample of all robots (skipping samples overwritten meanwhile)
+  double t = std::numeric_limits<double>::infinity();
+  double times[maxRobots];
+  for(uint j=0;j<ns;j++){
+    const rai::StateRing& H = slices[j]->history;
+    times[j] = std::numeric_limits<double>::infinity();
+    tmp.resize(H.rowSize());
+    uint64_t begin = H.begin();
+    if(next[j]<begin){ //fell behind the ring
+      if(dropped) *dropped += begin-next[j];
+      next[j] = begin;
+    }
+    for(; next[j]<H.end(); next[j]++){
+      if(H.read(next[j], tmp.p)){ times[j] = tmp.p[0]; break; }
+      if(dropped) (*dropped)++;
+    }
+    if(times[j]<t) t = times[j];
+  }
+  if(std::isinf(t) || t>tEnd) return false; //no sample left, or beyond tEnd
+
+  //-- the full state at t: robots ticking at t contribute their own sample, the others are interpolated
+  X[0] = t;
+  for(uint i=0;i<n;i++){ X[1+i] = q0.p[i];  X[1+n+i] = X[1+2*n+i] = 0.; }
+  for(uint j=0;j<ns;j++){
+    const StateSlice& s = *slices[j];
+    if(!s.history.end()) continue;
+    tmp.resize(s.history.rowSize());
+    if(times[j]==t && s.history.read(next[j], tmp.p)) next[j]++;
+    else s.history.sampleAt(t, tmp.p);
+    scatterRow(X, s, tmp.p);
+  }
+  return true;
+}
+
+CtrlChannel::TauSubscription CtrlChannel::subscribeTau() const{
+  TauSubscription sub;
+  uint ns = nSlices.load(std::memory_order_acquire);
+  for(uint j=0;j<ns;j++) sub.next[j] = slices[j]->history.end();
+  return sub;
+}
+
+void CtrlChannel::readTau(TauSubscription& sub, arr& times, arr& tau) const{
+  uint n = q0.N;
+  tau.clear();
+  if(!!times) times.clear();
+  uint ns = nSlices.load(std::memory_order_acquire);
+  arr rowX(1+3*n), tmp, tauRow;
+  double tEnd = historyHorizon(ns, tmp);
+  while(mergedRow(rowX.p, sub.next, ns, tEnd, tmp, &sub.dropped)){
+    if(!!times) times.append(rowX.p[0]);
+    tauRow.setCarray(rowX.p+1+2*n, n);
+    tau.append(tauRow);
+  }
+  if(tau.N) tau.reshape(-1, n);
+  else tau.resize(0, n);
+}
+
+std::shared_ptr<CtrlChannel::ForceMonitor> CtrlChannel::addForceMonitor(const arr& J, double threshold){
+  CHECK_EQ(J.nd, 2, "");
+  CHECK_EQ(J.d1, q0.N, "the Jacobian must have a column per joint of the channel");
+  std::lock_guard<std::mutex> lock(writeMutex);
+
+  //-- the robot owning all joints the Jacobian depends on
+  uint ns = nSlices.load(std::memory_order_acquire);
+  int owner=-1;
+  for(uint k=0;k<ns && owner<0;k++){
+    const uintA& qIndices = slices[k]->qIndices;
+    bool covers=true;
+    for(uint j=0;j<J.d1 && covers;j++){
+      bool nonzero=false;
+      for(uint i=0;i<J.d0;i++) if(J(i,j)!=0.){ nonzero=true; break; }
+      if(nonzero && qIndices.findValue(j)<0) covers=false;
+    }
+    if(covers) owner=k;
+  }
+  CHECK_GE(owner, 0, "the Jacobian depends on joints of several robots -- add one monitor per robot");
+
+  //-- f = (J J^T)^-1 J tau, restricted to the owner's joints
+  const uintA& qIndices = slices[owner]->qIndices;
+  arr P = inverse_SymPosDef(J*~J) * J;
+  auto m = make_shared<ForceMonitor>();
+  m->slot = owner;
+  m->threshold = threshold;
+  m->P.resize(J.d0, qIndices.N);
+  for(uint i=0;i<J.d0;i++) for(uint j=0;j<qIndices.N;j++) m->P(i,j) = P(i, qIndices(j));
+
+  //-- publish a new list to the robot threads
+  forceMonitorList.push_back(m);
+  forceMonitors.publish(new ForceMonitorList(forceMonitorList));
+  return m;
+}
+
+void CtrlChannel::removeForceMonitor(const std::shared_ptr<ForceMonitor>& m){
+  std::lock_guard<std::mutex> lock(writeMutex);
+  for(size_t i=0;i<forceMonitorList.size();i++) if(forceMonitorList[i]==m){
+    forceMonitorList.erase(forceMonitorList.begin()+i);
+    break;
+  }
+  forceMonitors.publish(new ForceMonitorList(forceMonitorList));
+}
+
+bool CtrlChannel::ForceMonitor::check(const double* tauExternal, double time){
+  double f2=0.;
+  for(uint i=0;i<P.d0;i++){
+    double fi=0.;
+    const double* Pi = P.p + i*P.d1;
+    for(uint j=0;j<P.d1;j++) fi += Pi[j]*tauExternal[j];
+    f2 += fi*fi;
+  }
+  double f = ::sqrt(f2);
+  force.store(f, std::memory_order_relaxed);
+  if(f<=threshold || triggered.load(std::memory_order_relaxed)) return false;
+  triggerTime.store(time, std::memory_order_relaxed);
+  triggered.store(true, std::memory_order_release);
+  return true;
+}
+
+void CtrlChannel::getTauExternal(arr& tau, TauCursor& cursor) const{
+  uint n = nSlices.load(std::memory_order_acquire);
+  if(cursor.integral.N!=q0.N) cursor.integral.resize(q0.N).setZero();
+  cursor.count.resize(maxRobots, 0);
+  tau.resize(q0.N).setZero();
+  arr integral(q0.N);
+  for(uint k=0;k<n;k++){
+    const StateSlice& s = *slices[k];
+    uint64_t count;
+    unsigned seq;
+    do{
+      seq = s.lock.readBegin();
+      for(uint i=0;i<s.qIndices.N;i++) integral.p[s.qIndices.p[i]] = s.tauExternalIntegral.p[i];
+      count = s.tauExternalCount;
+    }while(s.lock.readRetry(seq));
+
+    double m = double(count - cursor.count[k]);
+    for(uint i:s.qIndices){
+      if(m>0.) tau.p[i] = (integral.p[i] - cursor.integral.p[i])/m;
+      cursor.integral.p[i] = integral.p[i];
+    }
+    cursor.count[k] = count;
+  }
+}
+
+std::vector<rai::LoopTimingSummary> CtrlChannel::getTimingStats(bool reset){
+  std::vector<rai::LoopTimingSummary> stats;
+  uint n = nSlices.load(std::memory_order_acquire);
+  for(uint k=0;k<n;k++){
+    stats.push_back(slices[k]->timing.summary());
+    if(reset) slices[k]->timing.reset();
+  }
+  return stats;
+}
+
+void CtrlChannel::mirrorState(Var<rai::CtrlStateMsg>& state) const{
+  auto stateSet = state.set();
+  getState(stateSet->q, stateSet->qDot, stateSet->ctrlTime);
+  stateSet->tauExternalIntegral.resize(q0.N).setZero();
+  stateSet->tauExternalCount = 0;
+  uint n = nSlices.load(std::memory_order_acquire);
+  for(uint k=0;k<n;k++){
+    const StateSlice& s = *slices[k];
+    unsigned seq;
+    do{
+      seq = s.lock.readBegin();
+      for(uint i=0;i<s.qIndices.N;i++) stateSet->tauExternalIntegral.p[s.qIndices.p[i]] = s.tauExternalIntegral.p[i];
+      if(s.tauExternalCount > stateSet->tauExternalCount) stateSet->tauExternalCount = s.tauExternalCount;
+    }while(s.lock.readRetry(seq));
+  }
+}
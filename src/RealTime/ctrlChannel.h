@@ -0,0 +1,194 @@
+#pragma once
+
+#include <Core/thread.h>
+#include <Control/CtrlMsgs.h>
+
+#include "lockFree.h"
+#include "stateRing.h"
+#include "timingStats.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+//===========================================================================
+//
+// lock-free exchange of robot state and control commands between the robot (real-time)
+// threads and the user side (BotOp, MPC, python)
+//
+// * state: each robot thread owns one slice (its qIndices) and publishes into it under a
+//   SeqLock -- the robot thread never waits; readers assemble the full state from all slices
+// * commands: the user side writes the usual Var<CtrlCmdMsg>; a callback on that Var publishes
+//   a complete snapshot into one TripleBuffer per robot thread, which picks it up wait-free
+// * control time: a shared clock counted in epochs of ctrlDt (the period of the first
+//   registered robot). Each robot thread passes its own measured tick duration (e.g. libfranka's
+//   Duration); its epoch is the rounded accumulated time. The first robot to reach an epoch
+//   extends the clock; every robot reads the clock time *of its own epoch* -- so two arms
+//   ticking at the same rate sample the reference at exactly the same time points, regardless
+//   of their phase offset or of which one ticks first
+// * stall: a robot whose tracking error is too large requests a stall according to its policy:
+//   stallHoldAll freezes the shared clock for some epochs (all robots hold the reference);
+//   stallIgnore only counts the event
+// * waiting: user-side threads block until the clock reaches a time (e.g., the end of a motion);
+//   the robot threads check the earliest such time with one atomic load per tick and wake the
+//   waiters only when it is reached
+// * history: each robot thread also pushes its published state, stamped with the control time
+//   of its tick, into a StateRing of its slice (the last bot/stateHistory seconds) -- readers
+//   query the full state at a past time, interpolated per robot; torque subscribers stream every
+//   tick's tauExternal sample from these rings, each with its own cursor
+// * force monitors: task-space forces f = (J J^T)^-1 J tauExternal, checked against a threshold
+//   in the robot thread at every tick (the monitor list is read lock-free, RcuPointer)
+//
+
+struct CtrlChannel {
+  enum { maxRobots=8, clockHistory=64 };
+  enum StallPolicy { stallHoldAll=0, stallIgnore };
+  static StallPolicy stallPolicy(const char* name); ///< "holdAll" or "ignore" (e.g. from rai.cfg)
+
+  CtrlChannel(uint nJoints);
+  ~CtrlChannel();
+
+  /// publish every write to cmd as a snapshot to all registered robot threads
+  static void attach(const std::shared_ptr<CtrlChannel>& channel, Var<rai::CtrlCmdMsg>& cmd);
+
+  //-- robot thread side (all methods below are wait-free and allocation free)
+
+  /// register a robot thread owning the given joints; returns its slot (call once, before the loop).
+  /// ctrlDt: control time per tick; loopPeriod: wall time per tick (for timing stats; default ctrlDt)
+  uint registerRobot(const uintA& qIndices, const char* name, double ctrlDt, double loopPeriod=-1., StallPolicy stallPolicy=stallHoldAll);
+
+  /// advance this robot's clock by its measured tick duration dt; returns the control time of its epoch
+  /// (when a waiter's time is reached, this wakes the waiters via tryNotify -- it never blocks on waitMutex)
+  double tick(uint slot, double dt);
+  /// report too large tracking error; with stallHoldAll the shared clock holds for the given number of epochs
+  void requestStall(uint slot, int epochs);
+  /// set the clock's current time and each robot's last tick time (e.g., when a simulation restores a
+  /// snapshot -- only while no robot thread ticks); clears a pending stall. The next published samples
+  /// then carry this time, so a jump back restarts the state histories instead of spanning the jump
+  void setTime(double time);
+
+  /// publish this robot's joint state (vectors of size qIndices.N); tauExternal is accumulated
+  void publishState(uint slot, const double* q, const double* qDot, const double* tauExternal=0);
+
+  /// latest command snapshot for this robot's slot
+  const rai::CtrlCmdMsg& readCmd(uint slot);
+
+  /// latency histograms of this robot's loop (written by the robot thread only)
+  rai::LoopTiming& timing(uint slot){ return slices[slot]->timing; }
+
+  //-- reader side (any thread)
+
+  uint nJoints() const { return q0.N; }
+  double getCtrlTime() const { return ctrlTime.load(std::memory_order_acquire); }
+  /// assemble the full state from all slices; q and qDot are only resized if necessary
+  void getState(arr& q, arr& qDot, double& ctrlTime) const;
+  /// counts all state publications (of all robots)
+  uint64_t getRevision() const { return revision.load(std::memory_order_acquire); }
+
+  /// average external torques since the last call with the same cursor
+  struct TauCursor { arr integral; std::vector<uint64_t> count; };
+  void getTauExternal(arr& tau, TauCursor& cursor) const;
+
+  /// timing summaries of all registered robot loops; optionally resets the histograms
+  std::vector<rai::LoopTimingSummary> getTimingStats(bool reset=false);
+
+  /// copy the assembled state into a (legacy) state Var (blocking -- never call from a robot thread under BotOp)
+  void mirrorState(Var<rai::CtrlStateMsg>& state) const;
+
+  /// full state at control time t, each robot's slice interpolated in its history; false if some
+  /// robot's history does not cover t (its slice then holds the nearest sample)
+  bool getStateAt(double t, arr& q, arr& qDot, arr& tauExternal) const;
+  /// the history of all robots, merged in [t0,t1]: one row [time, q, qDot, tauExternal] per tick time of
+  /// any robot (robots ticking at that time contribute their own sample, the others are interpolated);
+  /// only up to the newest time that all publishing robots have reached
+  void getStateHistory(arr& X, double t0, double t1) const;
+
+  //-- external torque streaming (user side): each subscriber holds its own cursor
+
+  struct TauSubscription {
+    uint64_t next[maxRobots]={}; //per robot: history index of its next sample
+    uint64_t dropped=0;          //samples lost because the subscriber fell behind the history
+  };
+  /// a subscription delivering the samples from now on
+  TauSubscription subscribeTau() const;
+  /// all tauExternal samples since the last read: tau (n x nJoints) and their control times (n), one row per
+  /// tick time of any robot, as in getStateHistory (up to the newest time all publishing robots have reached)
+  void readTau(TauSubscription& sub, arr& times, arr& tau) const;
+
+  //-- force monitors
+
+  struct ForceMonitor {
+    uint slot;        //the robot whose thread checks the monitor
+    arr P;            //(J J^T)^-1 J, restricted to that robot's joints
+    double threshold;
+    std::atomic<bool> triggered={false};
+    std::atomic<double> triggerTime={-1.};
+    std::atomic<double> force={0.}; //|f| of the last tick
+    void reset(){ triggered=false; triggerTime=-1.; }
+    bool check(const double* tauExternal, double time); //robot thread; true when it triggers
+  };
+  /// monitor |f| > threshold, with f = (J J^T)^-1 J tauExternal the task-space force for a task Jacobian J
+  /// (k x nJoints, its non-zero columns within one robot's joints); a trigger wakes waitForTime
+  std::shared_ptr<ForceMonitor> addForceMonitor(const arr& J, double threshold);
+  void removeForceMonitor(const std::shared_ptr<ForceMonitor>& m);
+
+  /// block until the control time reaches t, notify() is called, or timeout [s] passed; returns whether t is reached
+  bool waitForTime(double t, double timeout);
+  /// wake all waiters (user-side events; blocks briefly on waitMutex)
+  void notify();
+  /// robot threads: wake all waiters if waitMutex is free right now; otherwise a later tick retries
+  void tryNotify();
+
+private:
+  struct StateSlice {
+    rai::SeqLock lock;
+    uintA qIndices;
+    StallPolicy stallPolicy=stallHoldAll;
+    double hwTime=0.;     //accumulated tick durations (robot thread only)
+    double time=0.;       //control time of the last tick (robot thread only)
+    int64_t epoch0=0, epoch=0;
+    arr q, qDot, tauExternalIntegral;
+    uint64_t tauExternalCount=0;
+    rai::LoopTiming timing;
+    rai::StateRing history;
+  };
+  struct CmdSlot {
+    rai::TripleBuffer<rai::CtrlCmdMsg> buf;
+  };
+
+  arr q0; //state of joints not owned by any robot
+  std::atomic<double> ctrlTime; //latest clock time, for readers
+  struct Clock {
+    rai::SpinLock lock; //among robot threads only
+    double dt=0.;
+    int64_t epoch=0, stallUntil=0;
+    double time[clockHistory]; //time of the last epochs, ring
+  } clock;
+  std::atomic<uint64_t> revision;
+
+  std::atomic<double> wakeTime; //earliest time a waiter waits for (inf: none; -inf: a failed tryNotify, retried next tick)
+  std::mutex waitMutex;
+  std::condition_variable waitCond;
+  uint64_t wakeCount=0; //under waitMutex: counts notifications
+
+  std::shared_ptr<StateSlice> slices[maxRobots];
+  std::shared_ptr<CmdSlot> cmdSlots[maxRobots];
+  std::atomic<uint> nSlices;
+
+  typedef std::vector<std::shared_ptr<ForceMonitor>> ForceMonitorList;
+  rai::RcuPointer<ForceMonitorList, maxRobots> forceMonitors; //reader r: robot slot r
+  ForceMonitorList forceMonitorList; //under writeMutex
+
+  std::mutex writeMutex; //serializes registration, command publication and monitor changes (user side only)
+  rai::CtrlCmdMsg lastCmd;
+
+  void publishCmd(const rai::CtrlCmdMsg& cmd);
+  /// scatter a slice's history row [time, q, qDot, tauExternal] into the full-state row X (of 1+3*nJoints)
+  void scatterRow(double* X, const StateSlice& s, const double* row) const;
+  /// newest time that the histories of all publishing robots have reached
+  double historyHorizon(uint ns, arr& tmp) const;
+  /// the next row of the merged history into X (of 1+3*nJoints), at the earliest next sample of any robot;
+  /// advances the cursors next[j] (one per robot) past the samples used, counting samples lost from the ring
+  /// into dropped; false if that time is beyond tEnd
+  bool mergedRow(double* X, uint64_t* next, uint ns, double tEnd, arr& tmp, uint64_t* dropped=0) const;
+};
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <Core/array.h>
+#include <Control/CtrlMsgs.h>
+
+#include "timingStats.h"
+
+#include <array>
+#include <cmath>
+
+//===========================================================================
+//
+// fixed-DOF control law kernels for the real-time loops (FrankaThread N=7, OmnibaseThread N=3)
+//
+// All storage is std::array on the stack/in the thread's workspace; all loop bounds are
+// compile-time constants, so that the compiler fully unrolls and vectorizes the NxN products.
+// Matrices are row-major NxN.
+//
+
+namespace rai {
+
+template<uint N>
+struct CtrlKernel {
+  typedef std::array<double, N> Vec;
+  typedef std::array<double, N*N> Mat;
+
+  /// the references of one robot, picked at its qIndices from the full-size command
+  struct Refs {
+    Vec q, qDot, qDDot;
+    Mat Kp, Kd, P; //Kp, Kd: projectedAcc gains; P: compliance projection
+    bool has_q=false, has_qDot=false, has_qDDot=false, has_Kp=false, has_Kd=false, has_P=false;
+
+    /// q_ref etc. are the full-size outputs of the reference callback (N=0: no reference)
+    void pickReferences(const arr& q_ref, const arr& qDot_ref, const arr& qDDot_ref, const uintA& qIndices){
+      has_q = q_ref.N;  has_qDot = qDot_ref.N;  has_qDDot = qDDot_ref.N;
+      if(has_q) CtrlKernel::pick(q, q_ref, qIndices);
+      if(has_qDot) CtrlKernel::pick(qDot, qDot_ref, qIndices);
+      if(has_qDDot) CtrlKernel::pick(qDDot, qDDot_ref, qIndices);
+    }
+    void clearReferences(){ has_q = has_qDot = has_qDDot = false; }
+
+    /// gains and compliance of the full-size command
+    void pickGains(const rai::CtrlCmdMsg& cmd, const uintA& qIndices){
+      has_Kp = isSquare(cmd.Kp);
+      has_Kd = isSquare(cmd.Kd);
+      has_P = cmd.P_compliance.N;
+      if(has_Kp) CtrlKernel::pick(Kp, cmd.Kp, qIndices);
+      if(has_Kd) CtrlKernel::pick(Kd, cmd.Kd, qIndices);
+      if(has_P) CtrlKernel::pick(P, cmd.P_compliance, qIndices);
+    }
+  };
+
+  //-- basic ops (y must not alias x)
+
+  static void pick(Vec& x, const arr& full, const uintA& qIndices){
+    for(uint i=0;i<N;i++) x[i] = full.elem(qIndices.elem(i));
+  }
+  static void pick(Mat& A, const arr& full, const uintA& qIndices){
+    for(uint i=0;i<N;i++) for(uint j=0;j<N;j++) A[N*i+j] = full(qIndices.elem(i), qIndices.elem(j));
+  }
+  static bool isSquare(const arr& A){ return A.nd==2 && A.d0>=N && A.d0==A.d1; }
+  static bool isZero(const Vec& x){
+    for(uint i=0;i<N;i++) if(x[i]!=0.) return false;
+    return true;
+  }
+
+  /// y = A x
+  static void mul(Vec& y, const Mat& A, const Vec& x){
+    for(uint i=0;i<N;i++){
+      double s=0.;
+      for(uint j=0;j<N;j++) s += A[N*i+j]*x[j];
+      y[i] = s;
+    }
+  }
+  /// y += A x
+  static void mulAdd(Vec& y, const Mat& A, const Vec& x){
+    for(uint i=0;i<N;i++){
+      double s=0.;
+      for(uint j=0;j<N;j++) s += A[N*i+j]*x[j];
+      y[i] += s;
+    }
+  }
+  /// K = P diag(k) P
+  static void projectGains(Mat& K, const Mat& P, const Vec& k){
+    for(uint i=0;i<N;i++) for(uint j=0;j<N;j++){
+      double s=0.;
+      for(uint l=0;l<N;l++) s += P[N*i+l] * k[l] * P[N*l+j];
+      K[N*i+j] = s;
+    }
+  }
+
+  //-- control law pieces
+
+  /// tracking error |q_ref - q| (in the P-metric if compliant); q_ref must be given
+  static double trackingError(const Refs& ref, const Vec& q){
+    Vec e;
+    for(uint i=0;i<N;i++) e[i] = ref.q[i] - q[i];
+    double err=0.;
+    if(ref.has_P){
+      for(uint i=0;i<N;i++) for(uint j=0;j<N;j++) err += e[i]*ref.P[N*i+j]*e[j];
+    }else{
+      for(uint i=0;i<N;i++) err += e[i]*e[i];
+    }
+    return ::sqrt(err);
+  }
+
+  /// whether configRefs uses the mass matrix (feedforward of a non-zero qDDot_ref)
+  static bool needsMass(const Refs& ref){ return ref.has_qDDot && !isZero(ref.qDDot); }
+
+  /// configRefs law:  u = P [ Kp' (q_ref-q) + Kd (qDot_ref-qDot) + M qDDot_ref + friction(qDot_ref) ]
+  /// with Kp' = P diag(Kp) P if compliant, diag(Kp) otherwise; M==0: no feedforward; friction==0: none
+  static void configRefs(Vec& u, const Refs& ref, const Vec& q, const Vec& qDot,
+                         const Vec& Kp, const Vec& Kd, const Mat* M=0, const double* friction=0, double velThresh=1e-3){
+    u.fill(0.);
+
+    //-- feedback term
+    if(ref.has_q){
+      Vec e;
+      for(uint i=0;i<N;i++) e[i] = ref.q[i] - q[i];
+      if(ref.has_P){
+        Mat KpMat;
+        projectGains(KpMat, ref.P, Kp);
+        mulAdd(u, KpMat, e);
+      }else{
+        for(uint i=0;i<N;i++) u[i] += Kp[i] * e[i];
+      }
+    }
+    if(ref.has_qDot){
+      for(uint i=0;i<N;i++) u[i] += Kd[i] * (ref.qDot[i] - qDot[i]);
+    }
+
+    //-- feedforward term
+    if(M && needsMass(ref)) mulAdd(u, *M, ref.qDDot);
+
+    //-- friction term
+    if(friction && ref.has_qDot){
+      for(uint i=0;i<N;i++){
+        double coeff = ref.qDot[i]/velThresh;
+        if(coeff>1.) coeff=1.;
+        if(coeff<-1.) coeff=-1.;
+        u[i] += coeff*friction[i];
+      }
+    }
+
+    //-- project with compliance
+    if(ref.has_P){
+      Vec tmp;
+      mul(tmp, ref.P, u);
+      u = tmp;
+    }
+  }
+
+  /// projectedAcc law:  u = M (qDDot_ref - Kp_ref q - Kd_ref qDot)  (requires Kp, Kd, qDDot references)
+  static void projectedAcc(Vec& u, const Refs& ref, const Vec& q, const Vec& qDot, const Mat& M){
+    Vec a;
+    for(uint i=0;i<N;i++){
+      double s = ref.qDDot[i];
+      for(uint j=0;j<N;j++) s -= ref.Kp[N*i+j]*q[j] + ref.Kd[N*i+j]*qDot[j];
+      a[i] = s;
+    }
+    mul(u, M, a);
+  }
+};
+
+//===========================================================================
+
+/// demand-driven, per-tick cache of the dynamics model (mass, coriolis, gravity): each quantity
+/// is evaluated at most once per tick, and only if asked for. Model/State follow libfranka's
+/// franka::Model::mass/coriolis/gravity(state) interface. Construct one per tick (on the stack).
+template<uint N, class Model, class State>
+struct LazyDynamics {
+  typedef typename CtrlKernel<N>::Vec Vec;
+  typedef typename CtrlKernel<N>::Mat Mat;
+
+  LazyDynamics(const Model& _model, const State& _state, Mat& _M, Vec& _C, Vec& _G, LatencyHistogram* _evalTime=0)
+    : model(_model), state(_state), M_(_M), C_(_C), G_(_G), evalTime(_evalTime) {}
+
+  const Mat& M(){ if(!has_M){ Timer t(*this); M_ = model.mass(state); has_M=true; } return M_; }
+  const Vec& C(){ if(!has_C){ Timer t(*this); C_ = model.coriolis(state); has_C=true; } return C_; }
+  const Vec& G(){ if(!has_G){ Timer t(*this); G_ = model.gravity(state); has_G=true; } return G_; }
+
+  bool has_M=false, has_C=false, has_G=false;
+  uint evaluations() const { return has_M + has_C + has_G; }
+
+private:
+  const Model& model;
+  const State& state;
+  Mat& M_;
+  Vec& C_;
+  Vec& G_;
+  LatencyHistogram* evalTime;
+
+  struct Timer {
+    LatencyHistogram* h;
+    uint64_t t0;
+    Timer(LazyDynamics& d) : h(d.evalTime), t0(h ? rtNow_ns() : 0) {}
+    ~Timer(){ if(h) h->add(rtNow_ns()-t0); }
+  };
+};
+
+} //namespace
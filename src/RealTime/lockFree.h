@@ -0,0 +1,205 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+//===========================================================================
+//
+// minimal lock-free building blocks for exchanging data with real-time threads
+//
+
+namespace rai {
+
+inline void cpuRelax(){
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+//===========================================================================
+
+/// minimal spin lock (usable with std::lock_guard) for a few nanoseconds of critical section
+/// shared among real-time threads only -- never hold it across anything that may block
+struct SpinLock {
+  std::atomic_flag flag = ATOMIC_FLAG_INIT;
+  void lock(){ while(flag.test_and_set(std::memory_order_acquire)) cpuRelax(); }
+  bool try_lock(){ return !flag.test_and_set(std::memory_order_acquire); }
+  void unlock(){ flag.clear(std::memory_order_release); }
+};
+
+//===========================================================================
+
+/// sequence lock: a single writer never waits; readers retry if they overlapped a write.
+/// The protected data must be plain memory that is not reallocated while readers exist.
+struct SeqLock {
+  std::atomic<unsigned> seq;
+
+  SeqLock() : seq(0) {}
+
+  void writeBegin(){
+    unsigned s = seq.load(std::memory_order_relaxed);
+    seq.store(s+1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+  void writeEnd(){
+    unsigned s = seq.load(std::memory_order_relaxed);
+    seq.store(s+1, std::memory_order_release);
+  }
+
+  unsigned readBegin() const {
+    unsigned s;
+    while((s=seq.load(std::memory_order_acquire)) & 1u) cpuRelax();
+    return s;
+  }
+  /// true if the read since readBegin() overlapped a write and needs to be repeated
+  bool readRetry(unsigned s) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return seq.load(std::memory_order_relaxed) != s;
+  }
+};
+
+//===========================================================================
+
+/// wait-free single-producer single-consumer exchange of complete snapshots:
+/// the producer fills writeBuffer() and publishes; the consumer picks up the latest
+/// published buffer with update() and reads it via readBuffer(). Neither side ever blocks,
+/// and the consumer never sees a partially written snapshot.
+template<class T>
+struct TripleBuffer {
+  T buf[3];
+
+  TripleBuffer() : middle(1), back(0), front(2) {}
+
+  //-- producer side
+  T& writeBuffer(){ return buf[back]; }
+  void publish(){
+    unsigned old = middle.exchange(back | freshBit, std::memory_order_acq_rel);
+    back = old & indexMask;
+  }
+
+  //-- consumer side
+  /// returns true if a new snapshot became the read buffer
+  bool update(){
+    if(!(middle.load(std::memory_order_relaxed) & freshBit)) return false;
+    unsigned old = middle.exchange(front, std::memory_order_acq_rel);
+    front = old & indexMask;
+    return true;
+  }
+  const T& readBuffer() const { return buf[front]; }
+
+private:
+  enum : unsigned { indexMask=3u, freshBit=4u };
+  std::atomic<unsigned> middle; //index of the middle buffer | freshBit
+  unsigned back;  //owned by the producer
+  unsigned front; //owned by the consumer
+};
+
+//===========================================================================
+
+/// wait-free single-producer single-consumer ring of fixed-size records (recordSize elements
+/// of T each). All memory is allocated in the constructor. The producer claims a record, fills
+/// it and pushes it; if the ring is full, claim() returns 0 and the record is to be dropped.
+template<class T>
+struct SpscRing {
+  SpscRing(unsigned capacity, unsigned recordSize)
+    : data(size_t(capacity)*recordSize), capacity(capacity), recordSize(recordSize), head(0), tail(0) {}
+
+  //-- producer side
+  T* claim(){
+    size_t h = head.load(std::memory_order_relaxed);
+    if(h - tail.load(std::memory_order_acquire) >= capacity) return 0;
+    return &data[(h%capacity)*recordSize];
+  }
+  void push(){ head.store(head.load(std::memory_order_relaxed)+1, std::memory_order_release); }
+
+  //-- consumer side
+  /// oldest record, or 0 if the ring is empty
+  const T* front() const {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if(t == head.load(std::memory_order_acquire)) return 0;
+    return &data[(t%capacity)*recordSize];
+  }
+  void pop(){ tail.store(tail.load(std::memory_order_relaxed)+1, std::memory_order_release); }
+
+  size_t size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+
+private:
+  std::vector<T> data;
+  const size_t capacity, recordSize;
+  std::atomic<size_t> head; //written by the producer only
+  std::atomic<size_t> tail; //written by the consumer only
+};
+
+//===========================================================================
+
+/// read-copy-update pointer to immutable snapshots: a writer publishes a new T with an
+/// atomic swap, readers never wait (hazard pointers; each reader slot r must be used by
+/// one thread at a time). Writers must be serialized by the caller; retired snapshots are
+/// deleted on later publishes, once no reader holds them.
+template<class T, unsigned maxReaders=8>
+struct RcuPointer {
+  RcuPointer() : current(nullptr) { for(unsigned r=0;r<maxReaders;r++) hazard[r].store(nullptr); }
+  ~RcuPointer(){
+    delete current.load();
+    for(T* p:retired) delete p;
+  }
+
+  /// reader: the current snapshot (or null), protected until release(r)
+  const T* acquire(unsigned r){
+    T* p;
+    do{
+      p = current.load(std::memory_order_seq_cst);
+      hazard[r].store(p, std::memory_order_seq_cst);
+    }while(p != current.load(std::memory_order_seq_cst));
+    return p;
+  }
+  void release(unsigned r){ hazard[r].store(nullptr, std::memory_order_release); }
+
+  /// writer: swap in a new snapshot (takes ownership), reclaim unreferenced old ones
+  void publish(T* p){
+    T* old = current.exchange(p, std::memory_order_seq_cst);
+    if(old) retired.push_back(old);
+    for(size_t i=0;i<retired.size();){
+      bool used=false;
+      for(unsigned r=0;r<maxReaders;r++) if(hazard[r].load(std::memory_order_seq_cst)==retired[i]){ used=true; break; }
+      if(used){ i++; continue; }
+      delete retired[i];
+      retired[i] = retired.back();
+      retired.pop_back();
+    }
+  }
+
+  bool empty() const { return !current.load(std::memory_order_acquire); }
+
+private:
+  std::atomic<T*> current;
+  std::atomic<T*> hazard[maxReaders];
+  std::vector<T*> retired; //writer side only
+};
+
+//===========================================================================
+
+/// binds each calling thread to one of n reader slots (e.g. of an RcuPointer), first come
+/// first served, for the lifetime of this object; a thread keeps its slot on every later call
+template<unsigned n>
+struct ThreadSlots {
+  ThreadSlots(){ for(unsigned i=0;i<n;i++) owner[i].store(std::thread::id()); }
+
+  /// the slot of the calling thread; -1 if all slots are bound to other threads
+  int get(){
+    std::thread::id me = std::this_thread::get_id();
+    for(unsigned i=0;i<n;i++) if(owner[i].load(std::memory_order_acquire)==me) return i;
+    for(unsigned i=0;i<n;i++){
+      std::thread::id none;
+      if(owner[i].compare_exchange_strong(none, me, std::memory_order_acq_rel)) return i;
+    }
+    return -1;
+  }
+
+private:
+  std::atomic<std::thread::id> owner[n];
+};
+
+} //namespace
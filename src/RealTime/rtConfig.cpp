@@ -0,0 +1,129 @@
+#include "rtConfig.h"
+
+#include <Core/util.h>
+
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include <alloca.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace rai {
+
+//CPUs claimed by pinned real-time threads (bit i: CPU i) -- excluded from the non-RT affinity
+static std::atomic<uint64_t> rtCpuMask(0);
+
+//===========================================================================
+
+RtThreadConfig RtThreadConfig::fromParams(const char* prefix, int index){
+  RtThreadConfig cfg;
+  cfg.priority = rai::getParameter<int>(STRING(prefix <<"/rtPriority"), 0);
+  cfg.cpu = rai::getParameter<int>(STRING(prefix <<"/cpu"), -1);
+  if(cfg.cpu>=0) cfg.cpu += index;
+  cfg.lockMemory = rai::getParameter<bool>("bot/lockMemory", false);
+  return cfg;
+}
+
+//===========================================================================
+
+void applyRtConfig(const RtThreadConfig& cfg, const char* threadName){
+  pthread_t self = pthread_self();
+
+  if(cfg.lockMemory){
+    lockProcessMemory();
+    prefaultStack();
+  }
+
+  if(cfg.cpu>=0){
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cfg.cpu, &set);
+    int r = pthread_setaffinity_np(self, sizeof(set), &set);
+    if(r) LOG(-1) <<threadName <<": could not pin to CPU " <<cfg.cpu <<" (" <<strerror(r) <<")";
+    else if(cfg.cpu<64) rtCpuMask.fetch_or(uint64_t(1)<<cfg.cpu);
+  }
+
+  if(cfg.priority>0){
+    sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = cfg.priority;
+    int r = pthread_setschedparam(self, SCHED_FIFO, &param);
+    if(r) LOG(-1) <<threadName <<": could not set SCHED_FIFO priority " <<cfg.priority <<" (" <<strerror(r) <<") -- check CAP_SYS_NICE / 'ulimit -r'";
+  }
+
+  //-- log what we actually got
+  int policy;
+  sched_param param;
+  pthread_getschedparam(self, &policy, &param);
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  pthread_getaffinity_np(self, sizeof(set), &set);
+  rai::String cpus;
+  for(int i=0;i<CPU_SETSIZE;i++) if(CPU_ISSET(i, &set)){ if(cpus.N) cpus <<','; cpus <<i; }
+  LOG(0) <<threadName <<" RT config: policy " <<(policy==SCHED_FIFO?"SCHED_FIFO":(policy==SCHED_RR?"SCHED_RR":"SCHED_OTHER"))
+         <<" priority " <<param.sched_priority <<", CPUs " <<cpus <<", memory " <<(cfg.lockMemory?"locked":"not locked");
+}
+
+//===========================================================================
+
+void applyNonRtAffinity(const char* threadName){
+  cpu_set_t set;
+  CPU_ZERO(&set);
+
+  arr nonRtCpus = rai::getParameter<arr>("bot/nonRtCpus", {});
+  if(nonRtCpus.N){
+    for(double c:nonRtCpus) CPU_SET(int(c), &set);
+  }else{
+    uint64_t rtMask = rtCpuMask.load();
+    if(!rtMask) return; //nothing pinned, nothing to keep away from
+    if(pthread_getaffinity_np(pthread_self(), sizeof(set), &set)) return;
+    for(int i=0;i<64;i++) if(rtMask & (uint64_t(1)<<i)) CPU_CLR(i, &set);
+    if(!CPU_COUNT(&set)){ LOG(-1) <<threadName <<": all CPUs are claimed by real-time threads -- not isolating"; return; }
+  }
+
+  int r = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if(r){ LOG(-1) <<threadName <<": could not set non-RT affinity (" <<strerror(r) <<")"; return; }
+  rai::String cpus;
+  for(int i=0;i<CPU_SETSIZE;i++) if(CPU_ISSET(i, &set)){ if(cpus.N) cpus <<','; cpus <<i; }
+  LOG(0) <<threadName <<" non-RT thread on CPUs " <<cpus;
+}
+
+//===========================================================================
+
+bool lockProcessMemory(uint64_t heapBytes){
+  static std::once_flag once;
+  static bool success=false;
+  std::call_once(once, [heapBytes](){
+    if(mlockall(MCL_CURRENT | MCL_FUTURE)){
+      LOG(-1) <<"mlockall failed (" <<strerror(errno) <<") -- check CAP_IPC_LOCK / 'ulimit -l'";
+      return;
+    }
+    //keep freed heap memory in the process (no trimming, no mmap'ed chunks), so that prefaulted pages stay
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+    if(heapBytes){
+      long page = sysconf(_SC_PAGESIZE);
+      char* buf = (char*)malloc(heapBytes);
+      if(buf){
+        for(uint64_t i=0; i<heapBytes; i+=page) ((volatile char*)buf)[i] = 0;
+        free(buf);
+      }
+    }
+    success=true;
+    LOG(0) <<"memory locked (mlockall), " <<(heapBytes>>20) <<"MB heap prefaulted";
+  });
+  return success;
+}
+
+void prefaultStack(uint64_t stackBytes){
+  //touch in page steps; alloca keeps the frame alive while we write
+  volatile char* buf = (volatile char*)alloca(stackBytes);
+  long page = sysconf(_SC_PAGESIZE);
+  for(uint64_t i=0; i<stackBytes; i+=page) buf[i] = 0;
+}
+
+} //namespace
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+//===========================================================================
+//
+// real-time configuration of threads: scheduling policy, CPU pinning, memory locking
+//
+// Read from rai.cfg, per thread kind (prefix 'Franka', 'Omnibase', 'botsim'):
+//
+//   <prefix>/rtPriority: 80      SCHED_FIFO priority 1..99 (0, default: ordinary SCHED_OTHER thread)
+//   <prefix>/cpu: 2              pin to this CPU (-1, default: no pinning); the robot with
+//                                index i is pinned to cpu+i (e.g., both arms on 2 and 3)
+//   bot/lockMemory: true         mlockall the process and prefault stack and heap (default: false)
+//   bot/nonRtCpus: [0, 1]        CPUs for the non-real-time threads (cameras, MPC/user thread);
+//                                default: all CPUs not claimed by a pinned real-time thread
+//   bot/nonRtUserThread: true    also move the thread constructing BotOp (default: false -- that
+//                                is the application's own thread, e.g. the python main thread)
+//
+// Everything is best effort: if a setting is refused (no CAP_SYS_NICE / rtprio limit, CPU
+// not available), a warning is logged and the thread runs with what it got. The effective
+// settings are logged when applied.
+//
+
+namespace rai {
+
+struct RtThreadConfig {
+  int priority=0;         ///< SCHED_FIFO priority; 0: keep SCHED_OTHER
+  int cpu=-1;             ///< pin to this CPU; -1: no pinning
+  bool lockMemory=false;  ///< mlockall (process-wide, once) and prefault the thread's stack
+
+  /// reads <prefix>/rtPriority, <prefix>/cpu (+index), and bot/lockMemory
+  static RtThreadConfig fromParams(const char* prefix, int index=0);
+};
+
+/// applies the configuration to the calling thread (call it from within the thread, before its loop)
+void applyRtConfig(const RtThreadConfig& cfg, const char* threadName);
+
+/// pins the calling non-real-time thread (and the threads it creates later) away from the real-time CPUs
+void applyNonRtAffinity(const char* threadName);
+
+/// mlockall(MCL_CURRENT|MCL_FUTURE), disables heap trimming, and prefaults heapBytes of heap; once per process
+bool lockProcessMemory(uint64_t heapBytes=64<<20);
+
+/// touches stackBytes of the calling thread's stack, so that later growth does not page fault
+void prefaultStack(uint64_t stackBytes=512<<10);
+
+} //namespace
@@ -0,0 +1,180 @@
+#include "splineRef.h"
+
+namespace rai {
+
+//===========================================================================
+
+/// derivatives 0..n of the p+1 non-zero basis functions of interval 'span' at u (NURBS book, A2.3);
+/// ders is (n+1) x (p+1)
+static void basisDerivatives(arr& ders, uint span, double u, uint p, uint n, const arr& U){
+  const uint maxP=8;
+  CHECK_LE(p, maxP, "spline degree too high");
+  double ndu[maxP+1][maxP+1], a[2][maxP+1], left[maxP+1], right[maxP+1];
+
+  ndu[0][0]=1.;
+  for(uint j=1;j<=p;j++){
+    left[j] = u - U.elem(span+1-j);
+    right[j] = U.elem(span+j) - u;
+    double saved=0.;
+    for(uint r=0;r<j;r++){
+      ndu[j][r] = right[r+1] + left[j-r];
+      double tmp = ndu[r][j-1]/ndu[j][r];
+      ndu[r][j] = saved + right[r+1]*tmp;
+      saved = left[j-r]*tmp;
+    }
+    ndu[j][j] = saved;
+  }
+
+  ders.resize(n+1, p+1).setZero();
+  for(uint j=0;j<=p;j++) ders(0, j) = ndu[j][p];
+  for(uint r=0;r<=p;r++){
+    uint s1=0, s2=1;
+    a[0][0]=1.;
+    for(uint k=1;k<=n && k<=p;k++){
+      double d=0.;
+      int rk = int(r)-int(k), pk = int(p)-int(k);
+      if(r>=k){
+        a[s2][0] = a[s1][0]/ndu[pk+1][rk];
+        d = a[s2][0]*ndu[rk][pk];
+      }
+      int j1 = (rk>=-1 ? 1 : -rk);
+      int j2 = (int(r)-1<=pk ? int(k)-1 : int(p)-int(r));
+      for(int j=j1;j<=j2;j++){
+        a[s2][j] = (a[s1][j]-a[s1][j-1])/ndu[pk+1][rk+j];
+        d += a[s2][j]*ndu[rk+j][pk];
+      }
+      if(int(r)<=pk){
+        a[s2][k] = -a[s1][k-1]/ndu[pk+1][r];
+        d += a[s2][k]*ndu[r][pk];
+      }
+      ders(k, r) = d;
+      std::swap(s1, s2);
+    }
+  }
+  double f=p;
+  for(uint k=1;k<=n;k++){
+    for(uint j=0;j<=p;j++) ders(k, j) *= f;
+    f *= double(p-k);
+  }
+}
+
+void SplineCursor::rebuild(uint degree, const arr& knots, const arr& ctrlPoints, uint _span){
+  span = _span;
+  t0 = knots.elem(span);
+  t1 = knots.elem(span+1);
+  uint dim = ctrlPoints.d1;
+
+  //Taylor coefficients at t0: c_d = x^(d)(t0) / d!
+  arr ders;
+  basisDerivatives(ders, span, t0, degree, degree, knots);
+  coeffs.resize(degree+1, dim).setZero();
+  double fac=1.;
+  for(uint d=0;d<=degree;d++){
+    if(d) fac *= d;
+    for(uint r=0;r<=degree;r++){
+      double b = ders(d, r)/fac;
+      if(!b) continue;
+      const double* P = &ctrlPoints(span-degree+r, 0);
+      double* c = &coeffs(d, 0);
+      for(uint i=0;i<dim;i++) c[i] += b*P[i];
+    }
+  }
+  rebuilds++;
+}
+
+void SplineCursor::eval(arr& x, arr& xDot, arr& xDDot, double t, uint degree, const arr& knots, const arr& ctrlPoints, uint64_t _version){
+  CHECK_EQ(ctrlPoints.nd, 2, "");
+  uint dim = ctrlPoints.d1;
+  uint first = degree, last = ctrlPoints.d0-1; //valid spans; parameter range [knots(first), knots(last+1)]
+  CHECK_EQ(knots.N, ctrlPoints.d0+degree+1, "inconsistent knots/ctrlPoints");
+
+  //-- outside the range: boundary point, no motion
+  bool before = t<knots.elem(first), after = t>=knots.elem(last+1);
+  if(before || after){
+    const double* P = &ctrlPoints(before ? 0 : ctrlPoints.d0-1, 0);
+    if(!!x) x.setCarray(P, dim);
+    if(!!xDot) xDot.resize(dim).setZero();
+    if(!!xDDot) xDDot.resize(dim).setZero();
+    return;
+  }
+
+  //-- find the interval: start from the cached one, step (ctrlTime is monotone; usually 0 or 1 steps)
+  bool valid = (version && version==_version && coeffs.d0==degree+1 && coeffs.d1==dim && span>=first && span<=last);
+  version=_version;
+  uint s = span;
+  if(!valid || t<knots.elem(s)){ //invalid, or going back in time: bisection
+    uint lo=first, hi=last+1;
+    while(hi-lo>1){ uint mid=(lo+hi)/2; if(t<knots.elem(mid)) hi=mid; else lo=mid; }
+    s=lo;
+  }
+  while(s<last && t>=knots.elem(s+1)) s++;
+  if(!valid || s!=span) rebuild(degree, knots, ctrlPoints, s);
+
+  //-- Horner evaluation of the polynomial piece and its derivatives
+  double u = t-t0;
+  if(!!x) x.resize(dim);
+  if(!!xDot) xDot.resize(dim);
+  if(!!xDDot) xDDot.resize(dim);
+  for(uint i=0;i<dim;i++){
+    double v=0., vd=0., vdd=0.;
+    for(int d=degree; d>=0; d--){
+      double c = coeffs.p[d*dim+i];
+      vdd = vdd*u + 2.*vd;
+      vd = vd*u + v;
+      v = v*u + c;
+    }
+    if(!!x) x.p[i]=v;
+    if(!!xDot) xDot.p[i]=vd;
+    if(!!xDDot) xDDot.p[i]=vdd;
+  }
+}
+
+//===========================================================================
+
+IncrementalBSplineReference::IncrementalBSplineReference(){
+  //the callback is called within the writer's access -> reading the data directly is safe
+  spline.addCallback([this](Var_base* var){
+    Var_data<BSpline>* x = dynamic_cast<Var_data<BSpline>*>(var);
+    CHECK(x, "");
+    publish(x->data);
+  });
+}
+
+void IncrementalBSplineReference::getReference(arr& q_ref, arr& qDot_ref, arr& qDDot_ref, const arr& q_real, const arr& qDot_real, double ctrlTime){
+  int i = cursorThreads.get(); //each calling thread keeps its own cursor, so its interval cache stays valid
+  if(i>=0){
+    Slot& slot = slots[i];
+    slot.lock.lock(); //only ever contended by cursorRebuilds()
+    const SplineSnapshot* S = snapshot.acquire(i);
+    if(S) slot.cursor.eval(q_ref, qDot_ref, qDDot_ref, ctrlTime, S->degree, S->knots, S->ctrlPoints, S->version);
+    snapshot.release(i);
+    slot.lock.unlock();
+    if(S) return;
+  }
+
+  //not initialized yet (the base initializes the spline at the real state, which publishes), or more concurrent callers than cursors
+  BSplineCtrlReference::getReference(q_ref, qDot_ref, qDDot_ref, q_real, qDot_real, ctrlTime);
+}
+
+void IncrementalBSplineReference::publish(const BSpline& sp){
+  //copies the spline as it is now -- writes are serialized, so versions follow the modifications
+  if(!sp.ctrlPoints.N) return;
+  SplineSnapshot* S = new SplineSnapshot;
+  S->degree = sp.degree;
+  S->knots = sp.knots;
+  S->ctrlPoints = sp.ctrlPoints;
+  S->version = ++version;
+  snapshot.publish(S);
+}
+
+uint64_t IncrementalBSplineReference::cursorRebuilds(){
+  uint64_t n=0;
+  for(uint i=0;i<maxCursors;i++){
+    slots[i].lock.lock();
+    n += slots[i].cursor.rebuilds;
+    slots[i].lock.unlock();
+  }
+  return n;
+}
+
+} //namespace
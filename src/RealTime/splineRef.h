@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Core/array.h>
+#include <Control/CtrlMsgs.h>
+
+#include "lockFree.h"
+
+//===========================================================================
+//
+// incremental evaluation of B-spline references in the control loops
+//
+// Within one knot interval a B-spline of degree p is a plain polynomial. SplineCursor caches
+// the active interval and the polynomial's coefficients (computed once from the basis function
+// derivatives); a tick then only costs a Horner evaluation. For the monotonically increasing
+// ctrlTime of a control loop the interval search is amortized O(1). The cache is rebuilt when
+// the interval changes or the spline is modified (e.g., overwriteSmooth from the MPC).
+//
+// The control loops do not read the spline Var at all: every modification publishes an
+// immutable copy (SplineSnapshot) with an atomic pointer swap (RCU), so a long overwrite on the
+// user/MPC side never blocks a 1kHz reader, and a reader always sees one consistent spline.
+//
+
+namespace rai {
+
+struct SplineCursor {
+  uint64_t version=0;  ///< spline version the cache was built from (0: invalid)
+  uint span=0;         ///< knot interval [knots(span), knots(span+1)) (de Boor index)
+  double t0=0., t1=0.; ///< interval bounds
+  arr coeffs;          ///< (degree+1) x dim polynomial coefficients in (t-t0)
+  uint64_t rebuilds=0; ///< number of cache rebuilds (statistics)
+
+  /// x, xDot, xDDot (each optional: NoArr to skip) of the spline (degree, knots, ctrlPoints) at t;
+  /// outside the knot range: the boundary point with zero derivatives
+  void eval(arr& x, arr& xDot, arr& xDDot, double t, uint degree, const arr& knots, const arr& ctrlPoints, uint64_t version);
+
+private:
+  void rebuild(uint degree, const arr& knots, const arr& ctrlPoints, uint span);
+};
+
+//===========================================================================
+
+/// immutable copy of a spline, as published to the control loops
+struct SplineSnapshot {
+  uint64_t version;
+  uint degree;
+  arr knots, ctrlPoints;
+};
+
+/// BSplineCtrlReference with lock-free, incremental evaluation in getReference: every calling
+/// thread (each robot loop, the user side) is bound to its own SplineCursor and reads the latest
+/// published SplineSnapshot. Every write to the spline Var publishes a snapshot from within that
+/// write access -- the base's writers (append, overwriteSmooth, overwriteHard) need no override
+/// and may also be called through a BSplineCtrlReference pointer.
+struct IncrementalBSplineReference : BSplineCtrlReference {
+  enum { maxCursors=8 };
+
+  IncrementalBSplineReference();
+
+  virtual void getReference(arr& q_ref, arr& qDot_ref, arr& qDDot_ref, const arr& q_real, const arr& qDot_real, double ctrlTime);
+
+  /// version of the latest published snapshot (0: none yet)
+  uint64_t getVersion(){ return version; }
+
+  /// total cache rebuilds of all cursors (statistics)
+  uint64_t cursorRebuilds();
+
+private:
+  struct Slot { SpinLock lock; SplineCursor cursor; };
+  Slot slots[maxCursors];
+  ThreadSlots<maxCursors> cursorThreads; //slot i: cursor and snapshot reader of one thread
+  RcuPointer<SplineSnapshot, maxCursors> snapshot;
+  std::atomic<uint64_t> version={0};
+
+  void publish(const BSpline& sp); //within the write access of the spline Var (which serializes publishes)
+};
+
+} //namespace
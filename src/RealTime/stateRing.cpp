@@ -0,0 +1,105 @@
+#include "stateRing.h"
+
+namespace rai {
+
+//===========================================================================
+
+void StateRing::init(uint _dim, uint _capacity){
+  CHECK_GE(_capacity, 2, "");
+  dim = _dim;
+  capacity = _capacity;
+  entries.resize(capacity, 2+3*dim).setZero();
+  for(uint i=0;i<capacity;i++) entries(i, 0) = -1.; //no index yet
+  locks.reset(new SeqLock[capacity]);
+  written = 0;
+  first = 0;
+  lastTime = 0.;
+}
+
+void StateRing::push(double time, const double* q, const double* qDot, const double* tauExternal){
+  uint64_t k = written.load(std::memory_order_relaxed);
+  if(k && time<lastTime) first.store(k, std::memory_order_release); //time jumped back: drop the older samples
+  lastTime = time;
+
+  double* e = entries.p + (k%capacity)*(2+3*dim);
+  SeqLock& lock = locks[k%capacity];
+  lock.writeBegin();
+  e[0] = double(k);
+  e[1] = time;
+  for(uint i=0;i<dim;i++){
+    e[2+i] = q[i];
+    e[2+dim+i] = qDot[i];
+    e[2+2*dim+i] = (tauExternal ? tauExternal[i] : 0.);
+  }
+  lock.writeEnd();
+  written.store(k+1, std::memory_order_release);
+}
+
+uint64_t StateRing::begin() const{
+  uint64_t n = end();
+  uint64_t b = (n>capacity ? n-capacity : 0);
+  return rai::MAX(b, first.load(std::memory_order_acquire));
+}
+
+bool StateRing::read(uint64_t k, double* row) const{
+  if(k>=end()) return false;
+  const double* e = entries.p + (k%capacity)*(2+3*dim);
+  const SeqLock& lock = locks[k%capacity];
+  double index;
+  unsigned seq;
+  do{
+    seq = lock.readBegin();
+    index = e[0];
+    for(uint i=0;i<1+3*dim;i++) row[i] = e[1+i];
+  }while(lock.readRetry(seq));
+  return index==double(k);
+}
+
+bool StateRing::readTime(uint64_t k, double& time) const{
+  const double* e = entries.p + (k%capacity)*(2+3*dim);
+  const SeqLock& lock = locks[k%capacity];
+  double index;
+  unsigned seq;
+  do{
+    seq = lock.readBegin();
+    index = e[0];
+    time = e[1];
+  }while(lock.readRetry(seq));
+  return index==double(k);
+}
+
+bool StateRing::find(double t, uint64_t& k) const{
+  uint64_t lo = begin(), hi = end(); //search in [lo, hi)
+  double time;
+  //the oldest entries may be overwritten while searching -- move lo up until readable
+  while(lo<hi && !readTime(lo, time)) lo++;
+  if(lo>=hi || time>t) return false;
+  //invariant: time(lo)<=t; find the last such index
+  while(hi-lo>1){
+    uint64_t mid = lo + (hi-lo)/2;
+    if(!readTime(mid, time)) return find(t, k); //overwritten meanwhile (rare): restart
+    if(time<=t) lo = mid; else hi = mid;
+  }
+  k = lo;
+  return true;
+}
+
+bool StateRing::sampleAt(double t, double* row) const{
+  uint64_t k;
+  if(!find(t, k)){ //older than the ring (or empty): nearest is the oldest
+    uint64_t b = begin();
+    while(b<end() && !read(b, row)) b++;
+    return false;
+  }
+  if(!read(k, row)) return sampleAt(t, row); //overwritten meanwhile (rare)
+  if(row[0]==t) return true;
+
+  arr next(rowSize());
+  if(!read(k+1, next.p)) return false; //t is newer than the newest sample: row holds the newest
+  double dt = next.p[0] - row[0];
+  double a = (dt>0. ? (t-row[0])/dt : 0.);
+  for(uint i=0;i<rowSize();i++) row[i] += a*(next.p[i]-row[i]);
+  return true;
+}
+
+} //namespace
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Core/array.h>
+
+#include "lockFree.h"
+
+#include <memory>
+
+//===========================================================================
+//
+// history of one robot's state: a ring of timestamped samples (time, q, qDot, tauExternal)
+//
+// One writer (the robot thread) pushes a sample per tick -- wait-free and allocation free.
+// Any number of readers copy samples by their absolute index k (0, 1, 2, ... since init);
+// each ring entry is guarded by its own SeqLock and carries its index, so a reader detects
+// an entry that was overwritten (k older than capacity samples) instead of misreading it.
+// Times are nondecreasing; if the writer's time jumps back (e.g., a restored simulation
+// snapshot), the earlier samples are dropped from the readable range.
+//
+
+namespace rai {
+
+struct StateRing {
+  uint dim=0, capacity=0;
+
+  StateRing(){}
+  StateRing(const StateRing&) = delete;
+
+  /// allocate for samples of dimension dim (before the writer starts)
+  void init(uint _dim, uint _capacity);
+
+  //-- writer side (one thread)
+
+  /// tauExternal==0: zeros
+  void push(double time, const double* q, const double* qDot, const double* tauExternal=0);
+
+  //-- reader side (any thread)
+
+  /// size of a sample row: [time, q, qDot, tauExternal]
+  uint rowSize() const { return 1+3*dim; }
+  /// index past the newest sample
+  uint64_t end() const { return written.load(std::memory_order_acquire); }
+  /// index of the oldest sample still in the ring (may be overwritten by the time it is read)
+  uint64_t begin() const;
+  /// copy sample k into row (of rowSize()); false if k is not (or no longer) in the ring
+  bool read(uint64_t k, double* row) const;
+  /// index of the newest sample with time<=t; false if there is none (t older than the ring, or empty)
+  bool find(double t, uint64_t& k) const;
+  /// the sample at time t, linearly interpolated between the enclosing samples; false if t is not
+  /// covered (row then holds the nearest sample, if any)
+  bool sampleAt(double t, double* row) const;
+
+private:
+  arr entries;                       //capacity x (2+3dim): [index, time, q, qDot, tauExternal]
+  std::unique_ptr<SeqLock[]> locks;  //one per entry
+  std::atomic<uint64_t> written={0};
+  std::atomic<uint64_t> first={0};   //oldest index since the last backward time jump
+  double lastTime=0.;                //writer only
+
+  bool readTime(uint64_t k, double& time) const;
+};
+
+} //namespace
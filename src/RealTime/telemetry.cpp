@@ -0,0 +1,173 @@
+#include "telemetry.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace rai {
+
+static const uint telemetryHeaderSize = 512;
+
+//===========================================================================
+
+struct TelemetryWriter : Thread {
+  TelemetryRecorder& rec;
+  rai::String filename, header;
+  std::ofstream fil;
+  bool failed=false;
+
+  TelemetryWriter(TelemetryRecorder& _rec, const char* _filename, const StringA& fieldNames, const uintA& fieldDims)
+    : Thread("TelemetryWriter", .01), rec(_rec), filename(_filename) {
+    header <<"RAI-TELEMETRY 1\nfields";
+    for(uint i=0; i<fieldNames.N; i++) header <<' ' <<fieldNames(i) <<' ' <<fieldDims(i);
+    header <<"\nrecordSize " <<rec.recordSize() <<'\n';
+    threadLoop();
+  }
+
+  ~TelemetryWriter(){
+    threadClose();
+    drain();
+    if(fil.is_open()){
+      writeHeader(); //with the final dropped count
+      fil.close();
+    }
+  }
+
+  /// the file is created with the first record
+  bool openFile(){
+    if(fil.is_open()) return true;
+    if(failed) return false;
+    fil.open(filename, std::ios::binary);
+    if(!fil.good()){
+      LOG(-1) <<"could not open telemetry file '" <<filename <<"' -- its records are dropped";
+      failed=true;
+      return false;
+    }
+    writeHeader();
+    return true;
+  }
+
+  void writeHeader(){
+    rai::String h = header;
+    h <<"dropped " <<rec.dropped() <<'\n';
+    CHECK_LE(h.N, telemetryHeaderSize, "telemetry header too long -- too many fields?");
+    char buf[telemetryHeaderSize];
+    memset(buf, 0, telemetryHeaderSize);
+    memcpy(buf, h.p, h.N);
+    std::streampos pos = fil.tellp();
+    fil.seekp(0);
+    fil.write(buf, telemetryHeaderSize);
+    if(pos>std::streampos(telemetryHeaderSize)) fil.seekp(pos);
+  }
+
+  void drain(){
+    const double* x = rec.ring.front();
+    if(!x) return;
+    bool ok = openFile();
+    for(; x; x=rec.ring.front()){
+      if(ok) fil.write((const char*)x, rec.recordSize()*sizeof(double));
+      rec.ring.pop();
+    }
+    if(ok) fil.flush();
+  }
+
+  void step(){ drain(); }
+};
+
+//===========================================================================
+
+TelemetryRecorder::TelemetryRecorder(const char* filename, const StringA& fieldNames, const uintA& fieldDims, uint capacity)
+  : _recordSize(sum(fieldDims)), _dropped(0), ring(capacity, _recordSize) {
+  CHECK_EQ(fieldNames.N, fieldDims.N, "");
+  writer = make_shared<TelemetryWriter>(*this, filename, fieldNames, fieldDims);
+}
+
+TelemetryRecorder::~TelemetryRecorder(){
+  writer.reset();
+}
+
+TelemetryRecorder::Record TelemetryRecorder::begin(){
+  Record rec;
+  rec.p = ring.claim();
+  return rec;
+}
+
+void TelemetryRecorder::commit(Record& rec){
+  if(!rec.p){ _dropped.fetch_add(1, std::memory_order_relaxed); return; }
+  CHECK_EQ(rec.i, _recordSize, "telemetry record does not match the declared fields");
+  ring.push();
+  rec.p=0;
+}
+
+TelemetryRecorder::Record& TelemetryRecorder::Record::operator()(const double* x, uint n){
+  if(p){
+    if(x) for(uint k=0; k<n; k++) p[i+k] = x[k];
+    else for(uint k=0; k<n; k++) p[i+k] = NAN;
+  }
+  i += n;
+  return *this;
+}
+
+//===========================================================================
+
+void TelemetryLog::read(const char* filename){
+  std::ifstream fil(filename, std::ios::binary);
+  if(!fil.good()) HALT("could not open telemetry file '" <<filename <<"'");
+
+  char buf[telemetryHeaderSize+1];
+  fil.read(buf, telemetryHeaderSize);
+  buf[telemetryHeaderSize]=0;
+  CHECK_EQ((uint)fil.gcount(), telemetryHeaderSize, "telemetry file '" <<filename <<"' is truncated");
+
+  std::istringstream hdr(buf);
+  std::string tag, line;
+  int version=0;
+  hdr >>tag >>version;
+  if(tag!="RAI-TELEMETRY" || version!=1) HALT("'" <<filename <<"' is not a telemetry file (version 1)");
+
+  fieldNames.clear();  fieldDims.clear();  fieldOffsets.clear();
+  uint recordSize=0;
+  while(hdr >>tag){
+    if(tag=="fields"){
+      std::getline(hdr, line);
+      std::istringstream fs(line);
+      std::string name;
+      uint dim;
+      while(fs >>name >>dim){
+        fieldNames.append(rai::String(name.c_str()));
+        fieldOffsets.append(recordSize);
+        fieldDims.append(dim);
+        recordSize += dim;
+      }
+    }else if(tag=="recordSize"){
+      uint n;
+      hdr >>n;
+      CHECK_EQ(n, recordSize, "inconsistent telemetry header");
+    }else if(tag=="dropped"){
+      hdr >>dropped;
+    }else{
+      std::getline(hdr, line); //unknown entry: skip
+    }
+  }
+  CHECK(recordSize, "telemetry file '" <<filename <<"' declares no fields");
+
+  fil.seekg(0, std::ios::end);
+  uint64_t bytes = uint64_t(fil.tellg()) - telemetryHeaderSize;
+  uint n = bytes / (recordSize*sizeof(double)); //a partially written last record is ignored
+  data.resize(n, recordSize);
+  fil.seekg(telemetryHeaderSize);
+  fil.read((char*)data.p, data.N*sizeof(double));
+}
+
+arr TelemetryLog::get(const char* fieldName) const{
+  for(uint i=0; i<fieldNames.N; i++) if(fieldNames(i)==fieldName){
+    uint off=fieldOffsets(i), dim=fieldDims(i);
+    arr x(data.d0, dim);
+    for(uint t=0; t<data.d0; t++) for(uint k=0; k<dim; k++) x(t, k) = data(t, off+k);
+    return x;
+  }
+  HALT("telemetry has no field '" <<fieldName <<"'");
+  return arr();
+}
+
+} //namespace
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <Core/array.h>
+#include <Core/thread.h>
+
+#include "lockFree.h"
+
+//===========================================================================
+//
+// binary telemetry of control loops (writeData)
+//
+// The real-time loop fills fixed-layout records of doubles into a wait-free SPSC ring;
+// a background thread drains the ring into a binary file. The file starts with a
+// 512-byte, zero-padded ASCII header:
+//
+//   RAI-TELEMETRY 1
+//   fields time 1 q 7 q_ref 7 ...      (name and dimension of each field, in record order)
+//   recordSize 15                      (doubles per record)
+//   dropped 0                          (records lost because the ring was full)
+//
+// followed by the records as native (little-endian) doubles. Fields that were not
+// available in a tick (e.g., no reference yet) are NaN. Read with rai::TelemetryLog or
+// src/RealTime/telemetry.py (numpy; also converts to the old ASCII .dat format).
+//
+// The file is only created with the first record. A loop therefore sets up its recorder
+// before it starts and records whenever writeData is on -- the loop never allocates or opens files.
+//
+
+namespace rai {
+
+struct TelemetryWriter;
+
+struct TelemetryRecorder {
+  TelemetryRecorder(const char* filename, const StringA& fieldNames, const uintA& fieldDims, uint capacity=1<<14);
+  ~TelemetryRecorder(); ///< drains all remaining records and closes the file (if any was recorded)
+
+  /// fills one record in field order; all methods are wait-free and allocation free
+  struct Record {
+    double* p=0;
+    uint i=0;
+    Record& operator()(double x){ if(p) p[i]=x; i++; return *this; }
+    /// x==0 writes NaNs (field not available this tick)
+    Record& operator()(const double* x, uint n);
+    Record& operator()(const arr& x, uint n){ return operator()(x.N==n?x.p:0, n); }
+  };
+
+  Record begin(); ///< start a record; if the ring is full the record is silently dropped (and counted)
+  void commit(Record& rec);
+
+  uint recordSize() const { return _recordSize; }
+  uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+private:
+  uint _recordSize;
+  std::atomic<uint64_t> _dropped;
+  SpscRing<double> ring;
+  std::shared_ptr<TelemetryWriter> writer;
+  friend struct TelemetryWriter;
+};
+
+//===========================================================================
+
+/// reads a telemetry file written by TelemetryRecorder
+struct TelemetryLog {
+  StringA fieldNames;
+  uintA fieldDims, fieldOffsets;
+  arr data; ///< records x recordSize
+  uint64_t dropped=0;
+
+  TelemetryLog(){}
+  TelemetryLog(const char* filename){ read(filename); }
+
+  void read(const char* filename);
+  /// all records of one field (records x dim)
+  arr get(const char* fieldName) const;
+};
+
+} //namespace
@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""Reader for binary telemetry files (z.panda*.tlm) written by rai::TelemetryRecorder.
+
+    import telemetry
+    log = telemetry.load('z.panda0.tlm')
+    plt.plot(log['time'], log['q'][:,0])
+
+Run as a script to convert to the old ASCII .dat format (one record per line, fields in
+record order), e.g. for the gnuplot scripts in test/*/plt:
+
+    python3 telemetry.py z.panda0.tlm [z.panda0.dat]
+"""
+
+import sys
+import numpy as np
+
+HEADER_SIZE = 512
+
+
+def read_header(filename):
+    with open(filename, 'rb') as f:
+        raw = f.read(HEADER_SIZE)
+    if len(raw) < HEADER_SIZE:
+        raise ValueError(f'{filename}: truncated telemetry file')
+    lines = raw.rstrip(b'\0').decode('ascii').splitlines()
+    if not lines or lines[0].split() != ['RAI-TELEMETRY', '1']:
+        raise ValueError(f'{filename}: not a telemetry file (version 1)')
+    header = {'fields': [], 'recordSize': 0, 'dropped': 0}
+    for line in lines[1:]:
+        key, *vals = line.split()
+        if key == 'fields':
+            header['fields'] = [(vals[i], int(vals[i+1])) for i in range(0, len(vals), 2)]
+        elif key in ('recordSize', 'dropped'):
+            header[key] = int(vals[0])
+    assert header['recordSize'] == sum(d for _, d in header['fields']), 'inconsistent telemetry header'
+    return header
+
+
+def load(filename, mmap=False):
+    """returns a dict field name -> array (records x dim; 1D for dim 1) plus 'data' (all records)
+    and 'dropped'; the field arrays are views into 'data'"""
+    header = read_header(filename)
+    n = header['recordSize']
+    if mmap:
+        data = np.memmap(filename, dtype='<f8', mode='r', offset=HEADER_SIZE)
+    else:
+        data = np.fromfile(filename, dtype='<f8', offset=HEADER_SIZE)
+    data = data[:(data.size//n)*n].reshape(-1, n)  # a partially written last record is ignored
+
+    log = {'data': data, 'dropped': header['dropped']}
+    off = 0
+    for name, dim in header['fields']:
+        log[name] = data[:, off] if dim == 1 else data[:, off:off+dim]
+        off += dim
+    return log
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+    src = sys.argv[1]
+    dst = sys.argv[2] if len(sys.argv) > 2 else src.rsplit('.', 1)[0] + '.dat'
+    log = load(src)
+    np.savetxt(dst, log['data'], fmt='%g')
+    print(f'{src}: {log["data"].shape[0]} records ({log["dropped"]} dropped) -> {dst}')
@@ -0,0 +1,103 @@
+#include "timingStats.h"
+
+namespace rai {
+
+//===========================================================================
+
+uint LatencyHistogram::bucketIndex(uint64_t ns){
+  if(ns < nLinear) return ns;
+  uint e = 63 - __builtin_clzll(ns); //>=4
+  if(e > maxExp) return nBuckets-1;
+  uint sub = (ns >> (e-subBits)) & ((1<<subBits)-1);
+  return nLinear + (e-4)*(1<<subBits) + sub;
+}
+
+uint64_t LatencyHistogram::bucketUpper(uint idx){
+  if(idx < nLinear) return idx;
+  uint e = (idx-nLinear)/(1<<subBits) + 4;
+  uint sub = (idx-nLinear)%(1<<subBits);
+  return (uint64_t((1<<subBits)+sub+1) << (e-subBits)) - 1;
+}
+
+void LatencyHistogram::reset(){
+  for(uint i=0; i<nBuckets; i++) buckets[i].store(0, std::memory_order_relaxed);
+  sum_ns.store(0, std::memory_order_relaxed);
+  max_ns.store(0, std::memory_order_relaxed);
+}
+
+LatencySummary LatencyHistogram::summary() const{
+  LatencySummary s;
+  uint64_t counts[nBuckets];
+  for(uint i=0; i<nBuckets; i++){ counts[i] = buckets[i].load(std::memory_order_relaxed); s.count += counts[i]; }
+  if(!s.count) return s;
+
+  uint64_t max = max_ns.load(std::memory_order_relaxed);
+  s.max = 1e-9*max;
+  s.mean = 1e-9*double(sum_ns.load(std::memory_order_relaxed))/double(s.count);
+
+  //percentiles as the upper bound of the bucket reaching the rank (clipped to the max)
+  auto percentile = [&](double p){
+    uint64_t rank = uint64_t(p*double(s.count-1)) + 1, c=0;
+    for(uint i=0; i<nBuckets; i++){
+      c += counts[i];
+      if(c >= rank) return 1e-9*double(rai::MIN(bucketUpper(i), max));
+    }
+    return s.max;
+  };
+  s.p50 = percentile(.5);
+  s.p90 = percentile(.9);
+  s.p99 = percentile(.99);
+  s.p999 = percentile(.999);
+  return s;
+}
+
+//===========================================================================
+
+LoopTimingSummary LoopTiming::summary() const{
+  LoopTimingSummary s;
+  s.name = name;
+  s.nominalPeriod = nominalPeriod;
+  s.overruns = overruns.load(std::memory_order_relaxed);
+  s.stalls = stalls.load(std::memory_order_relaxed);
+  s.duration = duration.summary();
+  s.period = period.summary();
+  s.reference = reference.summary();
+  s.lockWait = lockWait.summary();
+  s.dynamics = dynamics.summary();
+  s.dynamicsSkipped = dynamicsSkipped.load(std::memory_order_relaxed);
+  if(s.duration.count) s.dynamicsSavedPerTick = double(s.dynamicsSkipped)*s.dynamics.mean/double(s.duration.count);
+  return s;
+}
+
+void LoopTiming::reset(){
+  duration.reset();
+  period.reset();
+  reference.reset();
+  lockWait.reset();
+  dynamics.reset();
+  dynamicsSkipped.store(0, std::memory_order_relaxed);
+  overruns.store(0, std::memory_order_relaxed);
+  stalls.store(0, std::memory_order_relaxed);
+}
+
+//===========================================================================
+
+std::ostream& operator<<(std::ostream& os, const LatencySummary& s){
+  os <<"n:" <<s.count <<" mean:" <<1e6*s.mean <<"us p50:" <<1e6*s.p50 <<"us p90:" <<1e6*s.p90
+     <<"us p99:" <<1e6*s.p99 <<"us p99.9:" <<1e6*s.p999 <<"us max:" <<1e6*s.max <<"us";
+  return os;
+}
+
+std::ostream& operator<<(std::ostream& os, const LoopTimingSummary& s){
+  os <<"-- " <<s.name <<" (period " <<1e3*s.nominalPeriod <<"ms, overruns: " <<s.overruns <<", stalls: " <<s.stalls <<")"
+     <<"\n  duration:  " <<s.duration
+     <<"\n  period:    " <<s.period
+     <<"\n  reference: " <<s.reference
+     <<"\n  lockWait:  " <<s.lockWait;
+  if(s.dynamics.count || s.dynamicsSkipped)
+    os <<"\n  dynamics:  " <<s.dynamics <<" (skipped: " <<s.dynamicsSkipped <<", saved/tick: " <<1e6*s.dynamicsSavedPerTick <<"us)";
+  os <<endl;
+  return os;
+}
+
+} //namespace
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <Core/array.h>
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+//===========================================================================
+//
+// lock-free latency histograms for control loops
+//
+// Each robot thread owns a LoopTiming and records into it (single writer, wait-free);
+// any other thread may read a summary concurrently. Buckets are log-linear (8 per
+// power of two, i.e. ~12% resolution) over nanoseconds, up to ~20 minutes.
+//
+
+namespace rai {
+
+/// monotonic time in nanoseconds
+inline uint64_t rtNow_ns(){
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// percentiles of one histogram, all in seconds
+struct LatencySummary {
+  uint64_t count=0;
+  double mean=0., p50=0., p90=0., p99=0., p999=0., max=0.;
+};
+
+struct LatencyHistogram {
+  enum { nLinear=16, subBits=3, maxExp=40, nBuckets = nLinear + (maxExp-4+1)*(1<<subBits) };
+
+  LatencyHistogram(){ reset(); }
+
+  void add(uint64_t ns){
+    buckets[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    sum_ns.fetch_add(ns, std::memory_order_relaxed);
+    if(ns > max_ns.load(std::memory_order_relaxed)) max_ns.store(ns, std::memory_order_relaxed);
+  }
+
+  LatencySummary summary() const;
+  void reset();
+
+  static uint bucketIndex(uint64_t ns);
+  static uint64_t bucketUpper(uint idx);
+
+private:
+  std::atomic<uint64_t> buckets[nBuckets];
+  std::atomic<uint64_t> sum_ns, max_ns;
+};
+
+/// timings of one control loop thread
+struct LoopTimingSummary {
+  rai::String name;
+  double nominalPeriod=0.;
+  uint64_t overruns=0; ///< ticks whose duration exceeded the nominal period
+  uint64_t stalls=0;   ///< ticks with a stall request (tracking error too large)
+  LatencySummary duration;  ///< callback/step duration
+  LatencySummary period;    ///< start-to-start interval between ticks (jitter)
+  LatencySummary reference; ///< reference evaluation (ReferenceFeed::getReference)
+  LatencySummary lockWait;  ///< state/cmd exchange with the user side
+  LatencySummary dynamics;  ///< each single dynamics model evaluation (mass, coriolis or gravity)
+  uint64_t dynamicsSkipped=0;    ///< model evaluations avoided by lazy evaluation (vs. all, every tick)
+  double dynamicsSavedPerTick=0.; ///< estimated time saved per tick [s] (skipped * mean evaluation time / ticks)
+};
+
+struct LoopTiming {
+  rai::String name;
+  double nominalPeriod=0.;
+  LatencyHistogram duration, period, reference, lockWait, dynamics;
+  std::atomic<uint64_t> overruns, stalls, dynamicsSkipped;
+
+  LoopTiming() : overruns(0), stalls(0), dynamicsSkipped(0) {}
+
+  //-- writer side (the loop thread only)
+  void tickBegin(){
+    tickStart = rtNow_ns();
+    if(lastStart) period.add(tickStart-lastStart);
+    lastStart = tickStart;
+  }
+  void tickEnd(){
+    uint64_t d = rtNow_ns()-tickStart;
+    duration.add(d);
+    if(nominalPeriod>0. && d > uint64_t(1e9*nominalPeriod)) overruns.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  //-- reader side (any thread)
+  LoopTimingSummary summary() const;
+  void reset();
+
+private:
+  uint64_t tickStart=0, lastStart=0;
+};
+
+/// records the lifetime of the scope into a histogram
+struct LatencyScope {
+  LatencyHistogram& h;
+  uint64_t t0;
+  LatencyScope(LatencyHistogram& _h) : h(_h), t0(rtNow_ns()) {}
+  ~LatencyScope(){ h.add(rtNow_ns()-t0); }
+};
+
+std::ostream& operator<<(std::ostream& os, const LatencySummary& s);
+std::ostream& operator<<(std::ostream& os, const LoopTimingSummary& s);
+
+} //namespace
@@ -19,7 +19,12 @@ const double MAX_SPEED = 0.15; // in  mm/s
 static int msg_len=0;
 static uint8_t msg[301];
 
-const char *robotiqSerialPorts[2] = {"/dev/ttyUSB0", "/dev/ttyUSB1"};
+/// serial port of the whichRobot-th gripper (rai.cfg Robotiq/serialPorts, one per arm)
+static rai::String robotiqSerialPort(uint whichRobot){
+  StringA ports = rai::getParameter<StringA>("Robotiq/serialPorts", {"/dev/ttyUSB0", "/dev/ttyUSB1"});
+  CHECK_LE(whichRobot+1, ports.N, "no serial port for Robotiq gripper " <<whichRobot <<" -- add it to Robotiq/serialPorts");
+  return ports(whichRobot);
+}
 
 void writeHex(uint8_t *msg, int len){
   cout <<"\nSERIAL MSG: ";
@@ -67,12 +72,12 @@ static uint16_t rq_com_compute_crc(uint8_t const * adr, int32_t length ) {
 
 RobotiqGripper::RobotiqGripper(uint whichRobot) {
   //-- choose robot/ipAddress
-  CHECK_LE(whichRobot, 1, "");
+  rai::String port = robotiqSerialPort(whichRobot);
 
   boost::asio::io_service io;
   serialPort = std::make_shared<boost::asio::serial_port>(io);
 
-  serialPort->open(robotiqSerialPorts[whichRobot]);
+  serialPort->open(port.p);
 
   serialPort->set_option(boost::asio::serial_port_base::baud_rate(115200));
   serialPort->set_option(boost::asio::serial_port_base::stop_bits(boost::asio::serial_port_base::stop_bits::one));
@@ -0,0 +1,243 @@
+#include <RealTime/ctrlKernels.h>
+#include <RealTime/timingStats.h>
+#include <RealTime/ctrlChannel.h>
+#include <RealTime/splineRef.h>
+#include <Franka/franka.h>
+
+#include <thread>
+
+const char *USAGE =
+    "\nMicrobenchmarks of the real-time control path (no robot needed; the Franka loop runs against the fake backend)"
+    "\n";
+
+//===========================================================================
+
+typedef rai::CtrlKernel<7> K;
+
+struct CtrlProblem {
+  arr q, qDot, q_ref, qDot_ref, qDDot_ref, P, M, friction, Kp, Kd;
+  K::Refs ref;
+  K::Vec q7, qDot7, Kp7, Kd7;
+  K::Mat M7;
+
+  CtrlProblem(bool compliance){
+    q = randn(7);  qDot = randn(7);
+    q_ref = q + .01*randn(7);  qDot_ref = .1*randn(7);  qDDot_ref = randn(7);
+    arr A = randn(7,7);
+    M = A*~A + eye(7);
+    friction = rand(7);
+    Kp = rand(7)*400.;  Kd = rand(7)*40.;
+    if(compliance){ arr J = randn(2,7); P = eye(7) - ~J*inverse_SymPosDef(J*~J)*J; }
+
+    for(uint i=0;i<7;i++){
+      q7[i]=q(i);  qDot7[i]=qDot(i);  Kp7[i]=Kp(i);  Kd7[i]=Kd(i);
+      ref.q[i]=q_ref(i);  ref.qDot[i]=qDot_ref(i);  ref.qDDot[i]=qDDot_ref(i);
+      for(uint j=0;j<7;j++){ M7[7*i+j]=M(i,j);  if(P.N) ref.P[7*i+j]=P(i,j); }
+    }
+    ref.has_q = ref.has_qDot = ref.has_qDDot = true;
+    ref.has_P = P.N;
+  }
+
+  /// the previous dynamic-arr implementation of the configRefs law (FrankaThread before the kernels)
+  arr configRefs_arr(){
+    arr KpMat;
+    if(P.N) KpMat = P * (Kp % P);
+    else KpMat = diag(Kp);
+    arr u = zeros(7);
+    u += KpMat * (q_ref - q);
+    u += Kd % (qDot_ref - qDot);
+    if(absMax(qDDot_ref)>0.) u += M*qDDot_ref;
+    for(uint i=0;i<7;i++){
+      double coeff = qDot_ref.elem(i)/1e-3;
+      if(coeff>1.) coeff=1.;
+      if(coeff<-1.) coeff=-1.;
+      u.elem(i) += coeff*friction.elem(i);
+    }
+    if(P.N) u = P * u;
+    return u;
+  }
+};
+
+//===========================================================================
+
+void benchKernels(){
+  uint n = rai::getParameter<uint>("bench/iterations", 200000);
+
+  for(bool compliance:{false, true}){
+    CtrlProblem pb(compliance);
+
+    //-- consistency
+    K::Vec u7;
+    K::configRefs(u7, pb.ref, pb.q7, pb.qDot7, pb.Kp7, pb.Kd7, &pb.M7, pb.friction.p);
+    arr u = pb.configRefs_arr();
+    double err=0.;
+    for(uint i=0;i<7;i++) err = rai::MAX(err, fabs(u(i)-u7[i]));
+    CHECK_LE(err, 1e-8, "kernel and arr implementation disagree");
+
+    //-- timing
+    double sink=0.;
+    uint64_t t0 = rai::rtNow_ns();
+    for(uint k=0;k<n;k++){ u = pb.configRefs_arr(); sink += u.elem(k%7); }
+    uint64_t t1 = rai::rtNow_ns();
+    for(uint k=0;k<n;k++){
+      pb.ref.q[k%7] += 1e-12; //defeat hoisting
+      K::configRefs(u7, pb.ref, pb.q7, pb.qDot7, pb.Kp7, pb.Kd7, &pb.M7, pb.friction.p);
+      sink += u7[k%7];
+    }
+    uint64_t t2 = rai::rtNow_ns();
+
+    double arr_ns = double(t1-t0)/n, kernel_ns = double(t2-t1)/n;
+    cout <<"configRefs " <<(compliance?"with":"w/o ") <<" compliance:  arr: " <<arr_ns <<"ns  kernel<7>: " <<kernel_ns
+         <<"ns  speedup: " <<arr_ns/kernel_ns <<"  (max diff " <<err <<", checksum " <<sink <<")" <<endl;
+  }
+}
+
+//===========================================================================
+
+/// 1kHz reference evaluation of a long spline that an MPC overwrites at 10Hz: the plain
+/// BSplineCtrlReference vs. the incremental evaluation (both receive identical commands)
+void benchSplineReference(){
+  uint nKnots = rai::getParameter<uint>("bench/splineWaypoints", 2000);
+  double duration = rai::getParameter<double>("bench/splineSeconds", 20.);
+  uint mpcPeriod = 100; //ticks
+  uint mpcWaypoints = 20;
+
+  rai::BSplineCtrlReference plain;
+  rai::IncrementalBSplineReference incremental;
+  arr q0 = zeros(7), qDot0 = zeros(7);
+  arr q_ref, qDot_ref, qDDot_ref, q_ref2, qDot_ref2, qDDot_ref2;
+  plain.getReference(q_ref, qDot_ref, qDDot_ref, q0, qDot0, 0.); //initializes the splines
+  incremental.getReference(q_ref, qDot_ref, qDDot_ref, q0, qDot0, 0.);
+
+  arr path = .5*randn(nKnots, 7);
+  arr times = range(0., duration, nKnots-1);
+  times += times(1);
+  plain.append(path, times, 0.);
+  incremental.append(path, times, 0.);
+
+  rai::LatencyHistogram plainTime, incrementalTime;
+  double err=0.;
+  uint ticks = uint(duration*1000.);
+  for(uint k=0;k<ticks;k++){
+    double ctrlTime = .001*k;
+    if(k && !(k%mpcPeriod)){ //MPC overwrite: a short horizon starting .1sec ahead
+      arr mpcPath = .5*randn(mpcWaypoints, 7);
+      arr mpcTimes = range(.1, 1., mpcWaypoints-1);
+      plain.overwriteSmooth(mpcPath, mpcTimes, ctrlTime);
+      incremental.overwriteSmooth(mpcPath, mpcTimes, ctrlTime);
+    }
+    {
+      rai::LatencyScope t(plainTime);
+      plain.getReference(q_ref, qDot_ref, qDDot_ref, q0, qDot0, ctrlTime);
+    }
+    {
+      rai::LatencyScope t(incrementalTime);
+      incremental.getReference(q_ref2, qDot_ref2, qDDot_ref2, q0, qDot0, ctrlTime);
+    }
+    err = rai::MAX(err, absMax(q_ref-q_ref2));
+    err = rai::MAX(err, absMax(qDot_ref-qDot_ref2)/(1.+absMax(qDot_ref)));
+  }
+  CHECK_LE(err, 1e-6, "incremental spline evaluation disagrees");
+
+  cout <<"spline reference, " <<nKnots <<" waypoints, MPC overwrite every " <<mpcPeriod <<" ticks (max diff " <<err
+       <<", " <<incremental.cursorRebuilds() <<" cache rebuilds in " <<ticks <<" ticks)"
+       <<"\n  plain:       " <<plainTime.summary()
+       <<"\n  incremental: " <<incrementalTime.summary() <<endl;
+}
+
+//===========================================================================
+
+/// reader tail latency while a writer thread overwrites a long spline back-to-back:
+/// the plain reference (reader and writer share the spline's lock) vs. snapshot publishing
+template<class Ref> rai::LatencySummary splineContention(uint ticks, uint mpcWaypoints){
+  Ref ref;
+  arr q0 = zeros(7), qDot0 = zeros(7), q_ref, qDot_ref, qDDot_ref;
+  ref.getReference(q_ref, qDot_ref, qDDot_ref, q0, qDot0, 0.);
+  arr path = .5*randn(mpcWaypoints, 7);
+  ref.append(path, range(.1, 10., mpcWaypoints-1), 0.);
+
+  std::atomic<bool> done(false);
+  std::atomic<uint64_t> ctrlTicks(0);
+  std::thread writer([&](){
+    while(!done){
+      double ctrlTime = .001*ctrlTicks.load();
+      ref.overwriteSmooth(path, range(.1, 10., mpcWaypoints-1), ctrlTime);
+    }
+  });
+
+  rai::LatencyHistogram readTime;
+  for(uint k=0;k<ticks;k++){
+    {
+      rai::LatencyScope t(readTime);
+      ref.getReference(q_ref, qDot_ref, qDDot_ref, q0, qDot0, .001*k);
+    }
+    ctrlTicks = k;
+    rai::wait(.0002);
+  }
+  done = true;
+  writer.join();
+  return readTime.summary();
+}
+
+void benchSplineContention(){
+  uint ticks = rai::getParameter<uint>("bench/contentionTicks", 5000);
+  uint mpcWaypoints = rai::getParameter<uint>("bench/contentionWaypoints", 500);
+  cout <<"spline reference under concurrent overwrites (" <<mpcWaypoints <<" waypoints each):"
+       <<"\n  plain:    " <<splineContention<rai::BSplineCtrlReference>(ticks, mpcWaypoints)
+       <<"\n  snapshot: " <<splineContention<rai::IncrementalBSplineReference>(ticks, mpcWaypoints) <<endl;
+}
+
+//===========================================================================
+
+/// small sinusoidal motion around the initial configuration -- exercises reference, tracking, and stall logic
+struct WiggleReference : rai::ReferenceFeed {
+  arr q0;
+  double amplitude;
+  WiggleReference(double _amplitude) : amplitude(_amplitude) {}
+
+  virtual void getReference(arr& q_ref, arr& qDot_ref, arr& qDDot_ref, const arr& q_real, const arr& qDot_real, double ctrlTime){
+    if(!q0.N) q0 = q_real; //first call (from the control thread)
+    q_ref.resize(q0.N);  qDot_ref.resize(q0.N);  qDDot_ref.resize(q0.N);
+    double w = 2.*RAI_PI*.5; //.5Hz
+    for(uint i=0;i<q0.N;i++){
+      q_ref.elem(i) = q0.elem(i) + amplitude*::sin(w*ctrlTime);
+      qDot_ref.elem(i) = amplitude*w*::cos(w*ctrlTime);
+      qDDot_ref.elem(i) = -amplitude*w*w*::sin(w*ctrlTime);
+    }
+  }
+};
+
+void benchFakeFranka(){
+  double seconds = rai::getParameter<double>("bench/fakeFrankaSeconds", 5.);
+
+  Var<rai::CtrlCmdMsg> cmd;
+  Var<rai::CtrlStateMsg> state;
+  auto channel = make_shared<CtrlChannel>(7);
+  CtrlChannel::attach(channel, cmd);
+  cmd.set()->ref = make_shared<WiggleReference>(rai::getParameter<double>("bench/wiggle", .1));
+
+  {
+    FrankaThread robot(0, {0, 1, 2, 3, 4, 5, 6}, cmd, state, channel);
+    robot.writeData = rai::getParameter<int>("bench/writeData", 1); //include the telemetry path
+    rai::wait(seconds);
+  }
+
+  cout <<"fake Franka, " <<seconds <<"sec (jitter: " <<rai::getParameter<double>("FakeFranka/jitter", 20e-6)
+       <<"s, packetLoss: " <<rai::getParameter<double>("FakeFranka/packetLoss", 0.) <<"):" <<endl;
+  for(const rai::LoopTimingSummary& s:channel->getTimingStats()) cout <<s;
+}
+
+//===========================================================================
+
+int main(int argc,char **argv){
+  rai::initCmdLine(argc, argv);
+  cout <<USAGE <<endl;
+
+  rnd.seed(0);
+  benchKernels();
+  benchSplineReference();
+  benchSplineContention();
+  benchFakeFranka();
+
+  return 0;
+}
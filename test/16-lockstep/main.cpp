@@ -0,0 +1,194 @@
+#include <BotOp/bot.h>
+#include <BotOp/simulation.h>
+#include <Kin/viewer.h>
+
+const char *USAGE =
+    "\nLockstep simulation: a BotOp motion script run repeatedly at CPU speed, checking bit-reproducibility;"
+    "\nand branching candidate rollouts from a sim snapshot; the motion-done notification; the state history;"
+    "\nand tauExternal streaming to independent subscribers"
+    "\n";
+
+//===========================================================================
+
+/// runs a small motion script in a fresh BotOp and returns the joint trajectory (one row per control step)
+arr runScript(double& wallTime){
+  rai::Configuration C;
+  C.addFile(rai::raiPath("../rai-robotModels/scenarios/pandaSingle.g"));
+
+  BotOp bot(C, false);
+  CHECK(bot.isLockstep(), "set botsim/lockstep: true");
+
+  arr q0 = bot.get_qHome();
+  arr q1 = q0;
+  q1(1) += .4;
+  q1(3) += .3;
+
+  arr traj;
+  double t0 = rai::realTime();
+  bot.move((q1, q0, q1).reshape(-1, q0.N), {.5, 1., 2.});
+  while(bot.getTimeToEnd()>0.){
+    bot.stepSim(1);
+    traj.append(bot.get_q());
+  }
+  bot.moveTo(q0, 1., false);
+  bot.runUntilEnd();
+  traj.append(bot.get_q());
+  wallTime = rai::realTime()-t0;
+
+  traj.reshape(-1, q0.N);
+  return traj;
+}
+
+//===========================================================================
+
+/// MPC-style candidate checks: restore a mid-motion snapshot and roll out several candidates
+void branching(){
+  rai::Configuration C;
+  C.addFile(rai::raiPath("../rai-robotModels/scenarios/pandaSingle.g"));
+  BotOp bot(C, false);
+
+  arr q0 = bot.get_qHome();
+  bot.moveTo(q0+.2, 1., false);
+  bot.stepSim(50); //mid-motion
+  auto snap = bot.simSnapshot();
+
+  uint candidates = rai::getParameter<uint>("candidates", 100);
+  double restoreTime=0., rolloutTime=0.;
+  arr first;
+  for(uint k=0;k<candidates;k++){
+    double t0 = rai::realTime();
+    bot.simRestore(snap);
+    double t1 = rai::realTime();
+    arr target = q0 - .2 + .01*(k%2); //two alternating candidates
+    bot.move(~target, {.5}, true, bot.get_t());
+    bot.stepSim(50);
+    rolloutTime += rai::realTime()-t1;
+    restoreTime += t1-t0;
+    if(k==0) first = bot.get_q();
+    if(k==2) CHECK(!memcmp(first.p, bot.get_q().p, first.N*sizeof(double)), "restored rollout differs");
+  }
+  cout <<"branching: " <<candidates <<" candidates, restore: " <<1e6*restoreTime/candidates <<"us ("
+       <<candidates/restoreTime <<"/sec), 50-step rollout: " <<1e3*rolloutTime/candidates <<"ms" <<endl;
+
+  //a rollout's gripper command must not carry over into the next branch
+  bot.simRestore(snap);
+  double width = bot.getGripperPos(rai::_left);
+  bot.gripperClose(rai::_left);
+  bot.stepSim(50);
+  bot.simRestore(snap);
+  bot.stepSim(50);
+  CHECK_ZERO(bot.getGripperPos(rai::_left)-width, 1e-3, "gripper command leaked across simRestore");
+
+  //the history restarts at the restore, instead of spanning the jump back in time
+  arr X = bot.getStateHistory(0., bot.get_t());
+  for(uint k=1;k<X.d0;k++) CHECK_GE(X(k,0), X(k-1,0), "state history spans a restore");
+  CHECK_GE(X(0,0), snap->ctrlTime-1e-9, "");
+}
+
+//===========================================================================
+
+/// onMotionDone: the future must become ready once (and only once) simulated time passes the spline end
+void motionDone(){
+  rai::Configuration C;
+  C.addFile(rai::raiPath("../rai-robotModels/scenarios/pandaSingle.g"));
+  BotOp bot(C, false);
+
+  bot.moveTo(bot.get_qHome()+.1, 1., false);
+  double endTime = bot.get_t() + bot.getTimeToEnd();
+  std::atomic<uint> calls={0}; //incremented in the watcher thread
+  std::shared_future<void> done = bot.onMotionDone([&calls](){ calls++; });
+
+  while(done.wait_for(std::chrono::milliseconds(1))!=std::future_status::ready){
+    CHECK_LE(bot.get_t(), endTime+1., "no motion-done notification");
+    bot.stepSim(1);
+  }
+  CHECK_GE(bot.get_t(), endTime, "motion-done before the end of the motion");
+  CHECK_EQ(calls.load(), 1, "");
+  cout <<"motion done: end time " <<endTime <<", notified at " <<bot.get_t() <<endl;
+}
+
+//===========================================================================
+
+/// getStateAt must reproduce the states seen at each tick, and interpolate in between
+void stateHistory(){
+  rai::Configuration C;
+  C.addFile(rai::raiPath("../rai-robotModels/scenarios/pandaSingle.g"));
+  BotOp bot(C, false);
+
+  bot.moveTo(bot.get_qHome()+.1, 1., false);
+  arr times, qs;
+  for(uint k=0;k<50;k++){
+    bot.stepSim(1);
+    times.append(bot.get_t());
+    qs.append(bot.get_q());
+  }
+  qs.reshape(times.N, -1);
+
+  arr q, qDot;
+  for(uint k=0;k<times.N;k++){
+    CHECK(bot.getStateAt(times(k), q, qDot), "time " <<times(k) <<" not in the history");
+    CHECK_ZERO(maxDiff(q, qs[k]), 1e-12, "state at " <<times(k) <<" differs");
+  }
+  bot.getStateAt(.5*(times(10)+times(11)), q, qDot);
+  CHECK_ZERO(maxDiff(q, .5*(qs[10]+qs[11])), 1e-12, "interpolation");
+
+  arr X = bot.getStateHistory(times(0), times(-1));
+  CHECK_EQ(X.d0, times.N, "");
+  cout <<"state history: " <<X.d0 <<" samples of dimension " <<X.d1 <<" -- consistent" <<endl;
+}
+
+//===========================================================================
+
+/// each subscriber must get every tick's sample, independently of the others' reads
+void tauStreaming(){
+  rai::Configuration C;
+  C.addFile(rai::raiPath("../rai-robotModels/scenarios/pandaSingle.g"));
+  BotOp bot(C, false);
+
+  CtrlChannel::TauSubscription fast = bot.subscribeTauExternal(), slow = bot.subscribeTauExternal();
+  arr times, timesSlow;
+  uint nFast=0;
+  for(uint k=0;k<100;k++){
+    bot.stepSim(1);
+    nFast += bot.readTauExternal(fast, times).d0;
+  }
+  arr tau = bot.readTauExternal(slow, timesSlow);
+  CHECK_EQ(nFast, 100, "fast subscriber missed samples");
+  CHECK_EQ(tau.d0, 100, "slow subscriber missed samples");
+  CHECK_EQ(tau.d1, bot.get_q().N, "");
+  CHECK_EQ(fast.dropped+slow.dropped, 0, "");
+  cout <<"tau streaming: " <<tau.d0 <<" samples to each subscriber, " <<timesSlow(0) <<".." <<timesSlow(-1) <<endl;
+}
+
+//===========================================================================
+
+int main(int argc,char **argv){
+  rai::initCmdLine(argc, argv);
+  cout <<USAGE <<endl;
+
+  uint runs = rai::getParameter<uint>("runs", 3);
+  double tau = rai::getParameter<double>("botsim/tau", .01);
+
+  arr first;
+  for(uint k=0;k<runs;k++){
+    double wallTime;
+    arr traj = runScript(wallTime);
+    double simTime = tau*traj.d0;
+    cout <<"run " <<k <<": " <<traj.d0 <<" steps, " <<simTime <<"sec simulated in " <<wallTime <<"sec (" <<simTime/wallTime <<"x real time)";
+    if(!k){
+      first = traj;
+      cout <<endl;
+    }else{
+      bool identical = (traj.N==first.N && !memcmp(traj.p, first.p, traj.N*sizeof(double)));
+      cout <<(identical ? " -- bit-identical to run 0" : " -- DIFFERS from run 0") <<endl;
+      CHECK(identical, "lockstep runs are not reproducible");
+    }
+  }
+
+  branching();
+  motionDone();
+  stateHistory();
+  tauStreaming();
+
+  return 0;
+}
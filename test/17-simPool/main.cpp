@@ -0,0 +1,59 @@
+#include <BotOp/simPool.h>
+
+#include <thread>
+
+const char *USAGE =
+    "\nBatch rollouts on a pool of headless lockstep simulations: scaling with the number of workers"
+    "\n";
+
+//===========================================================================
+
+std::vector<BotSimScript> randomScripts(const rai::Configuration& C, uint n){
+  arr q0 = C.getJointState();
+  std::vector<BotSimScript> scripts(n);
+  for(BotSimScript& s:scripts){
+    arr q1 = q0 + .3*randn(q0.N);
+    arr q2 = q0 + .3*randn(q0.N);
+    s.move((q1, q2, q0).reshape(-1, q0.N), {1., 2., 3.});
+    s.move(~q1, {1.}, true, 2.5); //overwrite halfway, as an MPC would
+  }
+  return scripts;
+}
+
+//===========================================================================
+
+int main(int argc,char **argv){
+  rai::initCmdLine(argc, argv);
+  cout <<USAGE <<endl;
+
+  rai::Configuration C;
+  C.addFile(rai::raiPath("../rai-robotModels/scenarios/pandaSingle.g"));
+
+  uint nScripts = rai::getParameter<uint>("scripts", 64);
+  uint maxWorkers = rai::getParameter<uint>("maxWorkers", std::thread::hardware_concurrency());
+
+  rnd.seed(0);
+  std::vector<BotSimScript> scripts = randomScripts(C, nScripts);
+
+  uintA workerCounts;
+  for(uint n=1; n<maxWorkers; n*=2) workerCounts.append(n);
+  workerCounts.append(maxWorkers);
+
+  double wall1=0.;
+  for(uint n:workerCounts){
+    BotSimPool pool(C, n);
+    double t0 = rai::realTime();
+    std::vector<BotSimResult> results = pool.run(scripts);
+    double wall = rai::realTime()-t0;
+    if(n==1) wall1 = wall;
+
+    double simTime=0.;
+    uint contacts=0;
+    for(const BotSimResult& r:results){ simTime += r.simTime;  contacts += r.contacts.size(); }
+    double speedup = wall1/wall;
+    cout <<"workers: " <<n <<"  rollouts/sec: " <<nScripts/wall <<"  sim sec/sec: " <<simTime/wall
+         <<"  speedup: " <<speedup <<"  efficiency: " <<speedup/n <<"  (contact pairs: " <<contacts <<")" <<endl;
+  }
+
+  return 0;
+}
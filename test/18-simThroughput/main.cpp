@@ -0,0 +1,99 @@
+#include <BotOp/bot.h>
+#include <BotOp/simulation.h>
+#include <Kin/frame.h>
+
+const char *USAGE =
+    "\nThroughput of the simulation's per-step bookkeeping: pullDynamicStates against the number of frames;"
+    "\nand lockstep sim steps per second, idle and while following a spline reference"
+    "\n";
+
+//===========================================================================
+
+/// the former pullDynamicStates: a walk over all frames in every call
+void pullDynamicStates_allFrames(rai::Configuration& C, rai::Configuration& simC){
+  for(rai::Frame *f:C.frames){
+    if(f->inertia && f->inertia->type==rai::BT_dynamic){
+      f->set_X() = simC.frames(f->ID)->ensure_X();
+    }
+    if(f->joint && !f->joint->active && f->joint->dim==1){
+      f->joint->setDofs(simC.qInactive, f->joint->qIndex);
+    }
+  }
+}
+
+/// pandaSingle plus nStatic static boxes and nDynamic dynamic ones
+void addClutter(rai::Configuration& C, uint nStatic, uint nDynamic){
+  for(uint i=0;i<nStatic+nDynamic;i++){
+    rai::Frame *f = C.addFrame(STRING("clutter_" <<i));
+    f->setShape(rai::ST_box, {.02, .02, .02});
+    f->setPosition({-1.+.05*(i%40), 1.+.05*((i/40)%40), .05+.05*(i/1600)});
+    if(i>=nStatic) f->setMass(.01);
+  }
+}
+
+void benchPullDynamicStates(){
+  uint nDynamic = rai::getParameter<uint>("pull/dynamic", 10);
+  uint calls = rai::getParameter<uint>("pull/calls", 10000);
+
+  for(uint nStatic:uintA{0, 100, 1000, 5000}){
+    rai::Configuration C;
+    C.addFile(rai::raiPath("../rai-robotModels/scenarios/pandaSingle.g"));
+    addClutter(C, nStatic, nDynamic);
+    rai::Configuration simC;
+    simC.copy(C, true);
+
+    BotThreadedSim sim(C, {}, {}, {}, -1, -1., {}, 1);
+    sim.stepSim(10); //let the dynamic boxes move
+
+    double t0 = rai::realTime();
+    for(uint k=0;k<calls;k++) pullDynamicStates_allFrames(C, simC);
+    double tAll = (rai::realTime()-t0)/calls;
+
+    t0 = rai::realTime();
+    for(uint k=0;k<calls;k++) sim.pullDynamicStates(C);
+    double tIndexed = (rai::realTime()-t0)/calls;
+
+    cout <<"frames: " <<C.frames.N <<"  all-frames walk: " <<1e6*tAll <<"us  indexed: " <<1e6*tIndexed
+         <<"us  speedup: " <<tAll/tIndexed <<endl;
+  }
+}
+
+//===========================================================================
+
+void benchSteps(){
+  uint steps = rai::getParameter<uint>("steps/n", 20000);
+
+  rai::Configuration C;
+  C.addFile(rai::raiPath("../rai-robotModels/scenarios/pandaSingle.g"));
+  BotOp bot(C, false, 1);
+  arr q0 = bot.get_qHome();
+  double tau = rai::getParameter<double>("botsim/tau");
+
+  //-- idle: no reference (holds the current state)
+  double t0 = rai::realTime();
+  bot.stepSim(steps);
+  double idle = steps/(rai::realTime()-t0);
+
+  //-- following a spline that lasts longer than the run
+  double duration = 2.*steps*tau;
+  arr q1 = q0 + .2;
+  bot.move((q1, q0).reshape(2, -1), {.5*duration, duration});
+  t0 = rai::realTime();
+  bot.stepSim(steps);
+  double moving = steps/(rai::realTime()-t0);
+
+  cout <<"steps/sec  idle: " <<idle <<"  moving: " <<moving
+       <<"  (sim sec/sec moving: " <<moving*tau <<")" <<endl;
+}
+
+//===========================================================================
+
+int main(int argc,char **argv){
+  rai::initCmdLine(argc, argv);
+  cout <<USAGE <<endl;
+
+  benchPullDynamicStates();
+  benchSteps();
+
+  return 0;
+}
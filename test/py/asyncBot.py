@@ -0,0 +1,61 @@
+# asyncio: one event loop driving motion, gripper, camera and state events concurrently
+import sys, os
+sys.path.append(os.path.expanduser('~/git/botop/build'))
+import libry as ry
+import numpy as np
+import asyncio
+import time
+
+ry.params_add({'bot/display': 'headless'})
+
+C = ry.Config()
+C.addFile(ry.raiPath('../rai-robotModels/scenarios/pandaSingle.g'))
+bot = ry.BotOp(C, False)
+
+async def motion():
+    for k in range(3):
+        bot.moveTo(bot.get_qHome() + (.1 if k%2==0 else 0.), 1., False)
+        await bot.motionDoneAsync()
+        print('motion %d done at ctrl time %.3f' % (k, bot.get_t()))
+
+async def gripper():
+    bot.gripperClose(ry._left)
+    await bot.gripperDoneAsync(ry._left)
+    print('gripper closed at %.3f' % bot.get_t())
+    bot.gripperMove(ry._left)
+    await bot.gripperDoneAsync(ry._left)
+    print('gripper open at %.3f' % bot.get_t())
+
+async def camera():
+    for k in range(10):
+        await bot.newFrameAsync('cameraWrist')
+        img, depth = bot.getImageAndDepth('cameraWrist')
+    print('10 camera frames by %.3f' % bot.get_t())
+
+async def state():
+    n = 0
+    t0 = time.time()
+    while time.time()-t0 < 1.:
+        await bot.newStateAsync()
+        n += 1
+    print('%d state revisions awaited in 1 sec' % n)
+
+async def main():
+    await asyncio.gather(motion(), gripper(), camera(), state())
+
+asyncio.run(main())
+
+async def shutdown():
+    # an awaitable pending when BotOp shuts down is cancelled, not left hanging
+    global bot
+    bot.moveTo(bot.get_qHome() + .2, 10., False)
+    pending = asyncio.ensure_future(bot.motionDoneAsync())
+    await asyncio.sleep(.1)
+    del bot
+    try:
+        await asyncio.wait_for(pending, 2.)
+        print('shutdown: pending awaitable resolved?!')
+    except asyncio.CancelledError:
+        print('shutdown: pending awaitable cancelled')
+
+asyncio.run(shutdown())
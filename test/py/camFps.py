@@ -0,0 +1,47 @@
+# frames/sec reachable from python: zero-copy camera buffers, and other python threads running during blocking calls
+import sys, os
+sys.path.append(os.path.expanduser('~/git/botop/build'))
+import libry as ry
+import numpy as np
+import threading
+import time
+
+ry.params_add({'bot/useGripper': False, 'bot/display': 'headless', 'botsim/cameraRate': 1000.})
+
+C = ry.Config()
+C.addFile(ry.raiPath('../rai-robotModels/scenarios/pandaSingle.g'))
+cam = C.addFrame('benchCam', 'table')
+cam.setRelativePosition([0., 0., 1.2])
+cam.setAttributes({'width': 1280, 'height': 720, 'focalLength': 1.})
+
+bot = ry.BotOp(C, False)
+bot.getImageAndDepth('benchCam') #first render
+
+def fps(n, copy):
+    t0 = time.time()
+    for i in range(n):
+        img, depth = bot.getImageAndDepth('benchCam')
+        if copy: #what each call cost before: one copy of each buffer into numpy
+            img, depth = img.copy(), depth.copy()
+    return n/(time.time()-t0)
+
+n = 200
+print('1280x720 image+depth: %.1f frames/sec with copies (before), %.1f frames/sec zero-copy' % (fps(n, True), fps(n, False)))
+
+#-- GIL release: a python thread counting while the main thread blocks in wait()
+count = 0
+stop = False
+def counter():
+    global count
+    while not stop:
+        count += 1
+t = threading.Thread(target=counter)
+t.start()
+bot.moveTo(bot.get_qHome() + .1, 1., False)
+t0 = time.time()
+bot.wait(C, False, True)
+stop = True
+t.join()
+print('python thread ran %d iterations during a %.2fs wait (0 if the GIL were held)' % (count, time.time()-t0))
+
+del bot